@@ -1,11 +1,26 @@
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "objectlog.h"
+#include "objectlog_channel.h"
+#include "objectlog_persist.h"
+#include "objectlog_rollup.h"
+#include "objectlog_keyindex.h"
+#include "scatter_hugepage.h"
+#include "objectlog_fd.h"
+#include "objectlog_parallel.h"
+#include "objectlog_shard.h"
+#include "scatter_mirror.h"
+#include "objectlog_segment.h"
+#include "nt_copy.h"
 
 uint8_t logbuf[16384];
 
@@ -223,15 +238,666 @@ int test_multiring() {
 	}
 }
 
+static size_t read_object(objectlog_t *log, objectlog_iterator_t *iter, char *buf, size_t size) {
+	size_t len = 0;
+
+	while (!objectlog_iterator_is_err(iter)) {
+		uint8_t fragment_len;
+		const void *fragment = objectlog_get_fragment(log, iter, &fragment_len);
+
+		assert(len + fragment_len <= size);
+		memcpy(buf + len, fragment, fragment_len);
+		len += fragment_len;
+		objectlog_next(log, iter);
+	}
+
+	return len;
+}
+
+int test_channels() {
+	objectlog_t log;
+	objectlog_channels_t chans;
+	objectlog_channel_t channels[4];
+	objectlog_iterator_t index[ARRAY_SIZE(channels)][32];
+	unsigned int seq[ARRAY_SIZE(channels)] = { 0 };
+
+	assert(!objectlog_setup(&log));
+	for (int i = 0; i < ARRAY_SIZE(channels); i++) {
+		objectlog_channel_init(&channels[i], index[i], ARRAY_SIZE(index[i]));
+	}
+	assert(!objectlog_channels_init(&chans, &log, channels, ARRAY_SIZE(channels)));
+
+	for (int i = 0; i < 1000; i++) {
+		unsigned int id = rand() % ARRAY_SIZE(channels);
+		char strbuf[300];
+		int len;
+
+		len = snprintf(strbuf, sizeof(strbuf), "Channel %u entry %u %.*s", id, seq[id]++,
+			       rand() % 200, "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat.");
+		assert(!objectlog_channel_write_object(&chans, id, strbuf, len));
+
+		for (unsigned int ch = 0; ch < ARRAY_SIZE(channels); ch++) {
+			unsigned int num_entries = objectlog_channel_num_entries(&chans, ch);
+
+			assert(num_entries <= ARRAY_SIZE(index[ch]));
+			for (unsigned int idx = 0; idx < num_entries; idx++) {
+				objectlog_iterator_t iter;
+				char cmpbuf[300];
+				size_t cmplen;
+				char prefix[32];
+
+				objectlog_channel_iterator(&chans, ch, idx, &iter);
+				cmplen = read_object(&log, &iter, cmpbuf, sizeof(cmpbuf));
+				snprintf(prefix, sizeof(prefix), "Channel %u entry %u ", ch,
+					 seq[ch] - num_entries + idx);
+				assert(cmplen >= strlen(prefix));
+				assert(!memcmp(cmpbuf, prefix, strlen(prefix)));
+			}
+		}
+	}
+
+	objectlog_channels_release(&chans);
+
+	/* A full channel index must not evict entries of other channels */
+	assert(!objectlog_init(&log, logbuf, sizeof(logbuf)));
+	objectlog_channel_init(&channels[0], index[0], 2);
+	objectlog_channel_init(&channels[1], index[1], ARRAY_SIZE(index[1]));
+	assert(!objectlog_channels_init(&chans, &log, channels, 2));
+	for (int i = 0; i < 100; i++) {
+		assert(!objectlog_channel_write_object(&chans, 1, "entry", 5));
+	}
+	for (int i = 0; i < 3; i++) {
+		assert(!objectlog_channel_write_object(&chans, 0, "x", 1));
+	}
+	assert(objectlog_channel_num_entries(&chans, 0) == 2);
+	assert(objectlog_channel_num_entries(&chans, 1) == ARRAY_SIZE(index[1]));
+	assert(log.num_entries == 103);
+
+	/* Objects too large for the log leave the channel index untouched */
+	assert(objectlog_channel_write_object(&chans, 0, randombuf, sizeof(logbuf)));
+	assert(objectlog_channel_num_entries(&chans, 0) == 2);
+	objectlog_channels_release(&chans);
+	return 0;
+}
+
+int test_persist() {
+	objectlog_t log;
+	objectlog_persist_t persist;
+	static uint8_t stagebuf[4096];
+	static uint8_t filebuf[1024 * 1024];
+	FILE *file = tmpfile();
+	size_t len, offset = 0;
+	unsigned int num_objects = 0;
+	long last_seq = -1;
+
+	assert(file);
+	assert(!objectlog_setup(&log));
+	assert(!objectlog_persist_init(&persist, &log, fileno(file), stagebuf, sizeof(stagebuf)));
+	for (int i = 0; i < 5000; i++) {
+		char strbuf[64];
+
+		len = snprintf(strbuf, sizeof(strbuf), "%d", i);
+		assert(!objectlog_persist_write_object(&persist, strbuf, len));
+		/* Reading concurrently to the worker must not disturb it */
+		assert(objectlog_get_object_size(&log, log.num_entries - 1) == len);
+	}
+	assert(!objectlog_persist_flush(&persist));
+	assert(persist.num_flushed + objectlog_persist_num_lost(&persist) == 5000);
+	objectlog_persist_release(&persist);
+
+	len = fread(filebuf, 1, sizeof(filebuf), file);
+	assert(len < sizeof(filebuf));
+	while (offset < len) {
+		char strbuf[64] = { 0 };
+		size_t str_len = 0;
+		uint8_t hdr;
+
+		do {
+			hdr = filebuf[offset++];
+			memcpy(strbuf + str_len, filebuf + offset, hdr & 0x7f);
+			str_len += hdr & 0x7f;
+			offset += hdr & 0x7f;
+		} while (!(hdr & 0x80));
+		assert(atol(strbuf) > last_seq);
+		last_seq = atol(strbuf);
+		num_objects++;
+	}
+	assert(num_objects == persist.num_flushed);
+	assert(last_seq == 4999);
+	fclose(file);
+	return 0;
+}
+
+int test_regions() {
+	objectlog_t log;
+	static uint8_t regionbuf[4][1024];
+	bool in_use[ARRAY_SIZE(regionbuf)] = { false };
+	scatter_object_t scatter_list[] = {
+		{ .ptr = logbuf, .len = 2048 },
+		{ .ptr = logbuf + 2048, .len = 512 },
+		{ .len = 0 },
+	};
+	unsigned int seq = 0;
+
+	assert(!objectlog_init_fragmented_reserve(&log, scatter_list, ARRAY_SIZE(regionbuf)));
+	for (int i = 0; i < 3000; i++) {
+		unsigned int region = rand() % ARRAY_SIZE(regionbuf);
+		char strbuf[300];
+		int len;
+
+		if (rand() % 16 == 0) {
+			if (in_use[region]) {
+				if (!objectlog_remove_region(&log, regionbuf[region])) {
+					in_use[region] = false;
+					memset(regionbuf[region], 0xaa, sizeof(regionbuf[region]));
+				}
+			} else if (!objectlog_add_region(&log, regionbuf[region], sizeof(regionbuf[region]))) {
+				in_use[region] = true;
+			}
+		}
+
+		len = snprintf(strbuf, sizeof(strbuf), "Entry %u %.*s", seq++, rand() % 200,
+			       "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat.");
+		assert(!objectlog_write_object(&log, strbuf, len));
+
+		for (unsigned int idx = 0; idx < log.num_entries; idx++) {
+			objectlog_iterator_t iter;
+			char cmpbuf[300];
+			char prefix[32];
+			size_t cmplen;
+
+			objectlog_iterator(&log, idx, &iter);
+			cmplen = read_object(&log, &iter, cmpbuf, sizeof(cmpbuf));
+			snprintf(prefix, sizeof(prefix), "Entry %u ", seq - log.num_entries + idx);
+			assert(cmplen >= strlen(prefix));
+			assert(!memcmp(cmpbuf, prefix, strlen(prefix)));
+		}
+	}
+
+	return 0;
+}
+
+static int rollup_extract(objectlog_t *log, const objectlog_iterator_t *entry, void *priv,
+			  uint64_t *window, int64_t *value) {
+	char strbuf[32] = { 0 };
+
+	objectlog_read_object(log, entry, 0, strbuf, sizeof(strbuf) - 1);
+	*value = atol(strbuf);
+	*window = *value / 10;
+	return 0;
+}
+
+int test_rollup() {
+	objectlog_t log;
+	objectlog_rollup_t rollup;
+	objectlog_rollup_bucket_t buckets[64];
+
+	assert(!objectlog_setup(&log));
+	objectlog_rollup_init(&rollup, &log, buckets, ARRAY_SIZE(buckets), rollup_extract, NULL);
+	for (int i = 0; i < 5000; i++) {
+		objectlog_rollup_bucket_t summary;
+		char strbuf[64];
+		int len;
+
+		len = snprintf(strbuf, sizeof(strbuf), "%d %.*s", i, rand() % 40,
+			       "Lorem ipsum dolor sit amet, consectetur adipiscing elit");
+		assert(!objectlog_write_object(&log, strbuf, len));
+
+		for (int idx = 1; idx < rollup.num_buckets; idx++) {
+			const objectlog_rollup_bucket_t *bucket = objectlog_rollup_bucket(&rollup, idx);
+
+			assert(bucket->min == bucket->window * 10);
+			assert(bucket->max == bucket->min + bucket->count - 1);
+			assert(bucket->sum == (bucket->min + bucket->max) * bucket->count / 2);
+		}
+		assert(!objectlog_rollup_summary(&rollup, 0, UINT64_MAX, &summary));
+		assert(summary.max == i);
+		assert(summary.num_entries + rollup.num_untracked == log.num_entries);
+	}
+	objectlog_rollup_release(&rollup);
+
+	return 0;
+}
+
+static int keyindex_extract(objectlog_t *log, const objectlog_iterator_t *entry, void *priv,
+			    uint64_t *key) {
+	char strbuf[32] = { 0 };
+
+	objectlog_read_object(log, entry, 0, strbuf, sizeof(strbuf) - 1);
+	*key = atol(strbuf);
+	return 0;
+}
+
+int test_keyindex() {
+	objectlog_t log;
+	objectlog_keyindex_t index;
+	static uint8_t arena[64 * sizeof(objectlog_keyindex_slot_t) + 8];
+	int last_seq[37];
+
+	for (int i = 0; i < ARRAY_SIZE(last_seq); i++) {
+		last_seq[i] = -1;
+	}
+	assert(!objectlog_setup(&log));
+	assert(!objectlog_keyindex_init(&index, &log, arena + 1, sizeof(arena) - 1,
+					keyindex_extract, NULL));
+	for (int i = 0; i < 5000; i++) {
+		unsigned int key = rand() % ARRAY_SIZE(last_seq);
+		objectlog_iterator_t iter;
+		char strbuf[64];
+		char cmpbuf[64];
+		int len;
+
+		len = snprintf(strbuf, sizeof(strbuf), "%u %d", key, i);
+		assert(!objectlog_write_object(&log, strbuf, len));
+		last_seq[key] = i;
+
+		key = rand() % ARRAY_SIZE(last_seq);
+		if (objectlog_keyindex_lookup(&index, key, &iter)) {
+			assert(last_seq[key] < i + 1 - (int)log.num_entries);
+			continue;
+		}
+		len = read_object(&log, &iter, cmpbuf, sizeof(cmpbuf));
+		snprintf(strbuf, sizeof(strbuf), "%u %d", key, last_seq[key]);
+		assert(len == strlen(strbuf));
+		assert(!memcmp(cmpbuf, strbuf, len));
+	}
+	objectlog_keyindex_release(&index);
+
+	return 0;
+}
+
+int test_hugepage() {
+	objectlog_t log;
+	scatter_hugepage_t hp;
+	int err;
+
+	assert(!scatter_hugepage_alloc(&hp, 1024 * 1024, SCATTER_HUGEPAGE_NO_NODE, 0));
+	printf("Hugepage storage: %zu bytes in %zu byte pages\n", hp.map_len, hp.page_size);
+	assert(!objectlog_init_fragmented(&log, hp.scatter_list));
+	for (int i = 0; i < 1000; i++) {
+		assert(!objectlog_write_string(&log, "Hello World!"));
+	}
+	assert(objectlog_get_object_size(&log, -1) == strlen("Hello World!"));
+	/* Fallback storage is aligned for transparent hugepages */
+	assert(!((uintptr_t)hp.addr % (2 * 1024 * 1024)));
+	scatter_hugepage_free(&hp);
+
+	err = scatter_hugepage_alloc(&hp, 1024 * 1024, 0, 0);
+	printf("Hugepage storage on node 0: %d\n", err);
+	if (!err) {
+		scatter_hugepage_free(&hp);
+	}
+	assert(scatter_hugepage_alloc(&hp, 1024 * 1024, 1 << 20, 0) == -EINVAL);
+
+	return 0;
+}
+
+int test_fd() {
+	objectlog_t log;
+	int fds[2];
+	size_t offset = 0;
+	unsigned int num_entries;
+
+	assert(!objectlog_setup(&log));
+	assert(!pipe(fds));
+	random_bytes(randombuf, 32768);
+	assert(write(fds[1], randombuf, 32768) == 32768);
+	close(fds[1]);
+
+	while (offset < 32768) {
+		objectlog_ssize_t len = objectlog_write_from_fd(&log, fds[0], rand() % 2000 + 1, 0);
+		objectlog_iterator_t iter;
+
+		assert(len > 0);
+		assert(objectlog_get_object_size(&log, log.num_entries - 1) == len);
+		objectlog_iterator(&log, log.num_entries - 1, &iter);
+		assert(read_object(&log, &iter, (char *)cmpbuf, sizeof(cmpbuf)) == len);
+		assert(!memcmp(cmpbuf, randombuf + offset, len));
+		offset += len;
+	}
+	/* Nothing may be evicted for data that never arrives */
+	num_entries = log.num_entries;
+	assert(objectlog_write_from_fd(&log, fds[0], 8000, OBJECTLOG_FD_NONBLOCK) == 0);
+	assert(log.num_entries == num_entries);
+	close(fds[0]);
+
+	assert(!pipe(fds));
+	assert(!fcntl(fds[0], F_SETFL, O_NONBLOCK));
+	assert(objectlog_write_from_fd(&log, fds[0], 8000, OBJECTLOG_FD_NONBLOCK) == 0);
+	assert(log.num_entries == num_entries);
+	assert(!fcntl(fds[0], F_SETFL, 0));
+
+	/* Short records return like read, without waiting for @len bytes */
+	assert(write(fds[1], "record", 6) == 6);
+	assert(objectlog_write_from_fd(&log, fds[0], 1000, 0) == 6);
+	close(fds[0]);
+	close(fds[1]);
+
+	return 0;
+}
+
+typedef struct {
+	unsigned long count;
+	unsigned long sum;
+} parallel_acc_t;
+
+static void parallel_count(objectlog_t *log, const objectlog_iterator_t *entry, void *acc,
+			   void *priv) {
+	parallel_acc_t *parallel_acc = acc;
+	char strbuf[32] = { 0 };
+
+	objectlog_read_object(log, entry, 0, strbuf, sizeof(strbuf) - 1);
+	parallel_acc->count++;
+	parallel_acc->sum += atol(strbuf);
+}
+
+static void parallel_reduce(void *acc, const void *other, void *priv) {
+	parallel_acc_t *parallel_acc = acc;
+	const parallel_acc_t *parallel_other = other;
+
+	parallel_acc->count += parallel_other->count;
+	parallel_acc->sum += parallel_other->sum;
+}
+
+static void check_parallel(objectlog_t *log, size_t max_padding) {
+	static char padding[400];
+	objectlog_iterator_t points[256];
+	objectlog_checkpoints_t checkpoints;
+	unsigned long sum = 0;
+	int i;
+
+	objectlog_checkpoints_init(&checkpoints, log, points, ARRAY_SIZE(points), 16);
+	memset(padding, 'x', sizeof(padding) - 1);
+	for (i = 0; i < 3000; i++) {
+		char strbuf[sizeof(padding) + 16];
+		int len;
+
+		len = snprintf(strbuf, sizeof(strbuf), "%d %.*s", i, (int)(rand() % max_padding),
+			       padding);
+		assert(!objectlog_write_object(log, strbuf, len));
+	}
+	for (i = 3000 - log->num_entries; i < 3000; i++) {
+		sum += i;
+	}
+
+	for (unsigned int num_threads = 1; num_threads <= 8; num_threads++) {
+		objectlog_parallel_pool_t pool;
+
+		assert(!objectlog_parallel_pool_init(&pool, num_threads));
+		for (int round = 0; round < 3; round++) {
+			parallel_acc_t accs[8] = { 0 };
+			objectlog_checkpoints_t *cps = round ? &checkpoints : NULL;
+
+			assert(!objectlog_parallel_for_each(&pool, log, cps, parallel_count,
+							    parallel_reduce, accs, sizeof(*accs), NULL));
+			/* Checkpoints split the log evenly by number of objects */
+			for (unsigned int idx = 1; cps && idx < num_threads; idx++) {
+				assert(accs[idx].count <= log->num_entries / num_threads + 2 * 16);
+			}
+			assert(accs[0].count == log->num_entries);
+			assert(accs[0].sum == sum);
+		}
+		objectlog_parallel_pool_release(&pool);
+	}
+	objectlog_checkpoints_release(&checkpoints);
+}
+
+int test_parallel() {
+	objectlog_t log;
+	scatter_mirror_t mirror;
+
+	assert(!objectlog_setup(&log));
+	check_parallel(&log, 40);
+
+	/* Fragments cross the end of mirrored rings */
+	assert(!scatter_mirror_alloc(&mirror, 4096));
+	assert(!objectlog_init_mirrored(&log, &mirror.ring, mirror.meta, mirror.meta_len));
+	check_parallel(&log, 390);
+	scatter_mirror_free(&mirror);
+
+	return 0;
+}
+
+typedef struct {
+	objectlog_shards_t *shards;
+	unsigned int shard;
+	pthread_t thread;
+} shard_writer_t;
+
+static void *shard_write(void *arg) {
+	shard_writer_t *writer = arg;
+
+	for (int i = 0; i < 2000; i++) {
+		char strbuf[64];
+		int len;
+
+		len = snprintf(strbuf, sizeof(strbuf), "Shard %u entry %d", writer->shard, i);
+		assert(!objectlog_shard_write_object(writer->shards, writer->shard, strbuf, len));
+	}
+
+	return NULL;
+}
+
+int test_shards() {
+	objectlog_t logs[4];
+	objectlog_shards_t shards;
+	objectlog_shard_merge_t merge;
+	shard_writer_t writers[ARRAY_SIZE(logs)];
+	unsigned int num_objects = 0;
+	scatter_object_t pool[] = {
+		{ .ptr = logbuf, .len = 5000 },
+		{ .ptr = logbuf + 5000, .len = sizeof(logbuf) - 5000 },
+		{ .len = 0 },
+	};
+	objectlog_iterator_t iter;
+	unsigned int shard;
+	uint64_t seq;
+	long last_seq = -1;
+
+	assert(!objectlog_shards_init(&shards, logs, ARRAY_SIZE(logs), pool));
+	for (shard = 0; shard < ARRAY_SIZE(logs); shard++) {
+		writers[shard].shards = &shards;
+		writers[shard].shard = shard;
+		assert(!pthread_create(&writers[shard].thread, NULL, shard_write, &writers[shard]));
+	}
+	for (shard = 0; shard < ARRAY_SIZE(logs); shard++) {
+		pthread_join(writers[shard].thread, NULL);
+	}
+
+	objectlog_shard_merge_init(&merge, &shards);
+	while (!objectlog_shard_merge_next(&merge, &shard, &seq, &iter)) {
+		char cmpbuf[64] = { 0 };
+
+		assert((long)seq > last_seq);
+		last_seq = seq;
+		read_object(&logs[shard], &iter, cmpbuf, sizeof(cmpbuf) - 1);
+		assert(!strncmp(cmpbuf, "Shard ", 6) && atoi(cmpbuf + 6) == shard);
+		num_objects++;
+	}
+	for (shard = 0; shard < ARRAY_SIZE(logs); shard++) {
+		num_objects -= logs[shard].num_entries;
+	}
+	assert(!num_objects);
+	assert(last_seq == ARRAY_SIZE(logs) * 2000 - 1);
+
+	return 0;
+}
+
+int test_mirror() {
+	objectlog_t log;
+	scatter_mirror_t mirror;
+
+	assert(!scatter_mirror_alloc(&mirror, 8192));
+	assert(!objectlog_init_mirrored(&log, &mirror.ring, mirror.meta, mirror.meta_len));
+	for (int i = 0; i < 5000; i++) {
+		size_t len = rand() % 600 + 1;
+		objectlog_iterator_t iter;
+
+		random_bytes(randombuf, len);
+		assert(!objectlog_write_object(&log, randombuf, len));
+		objectlog_iterator(&log, log.num_entries - 1, &iter);
+		/* Small objects are never split at the end of the ring */
+		if (len <= 127) {
+			uint8_t fragment_len;
+			const void *fragment = objectlog_get_fragment(&log, &iter, &fragment_len);
+
+			assert(fragment_len == len);
+			assert(!memcmp(fragment, randombuf, len));
+		}
+		assert(read_object(&log, &iter, (char *)cmpbuf, sizeof(cmpbuf)) == len);
+		assert(!memcmp(cmpbuf, randombuf, len));
+	}
+	scatter_mirror_free(&mirror);
+
+	return 0;
+}
+
+static const char *segment_words[] = { "alpha", "beta", "gamma", "delta", "epsilon" };
+
+static int segment_extract(objectlog_t *log, const objectlog_iterator_t *entry, void *priv,
+			   uint64_t *key, uint64_t *tokens, unsigned int *num_tokens) {
+	char strbuf[64] = { 0 };
+	char *word;
+
+	objectlog_read_object(log, entry, 0, strbuf, sizeof(strbuf) - 1);
+	*key = atol(strbuf);
+	word = strchr(strbuf, ' ') + 1;
+	tokens[0] = objectlog_segment_hash(word, strlen(word));
+	*num_tokens = 1;
+	return 0;
+}
+
+typedef struct {
+	uint64_t key_min;
+	uint64_t key_max;
+	const char *word;
+	unsigned int num_visited;
+	unsigned int num_matches;
+} segment_query_t;
+
+static int segment_visit(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	segment_query_t *query = priv;
+	char strbuf[64] = { 0 };
+	uint64_t key;
+
+	objectlog_read_object(log, entry, 0, strbuf, sizeof(strbuf) - 1);
+	key = atol(strbuf);
+	query->num_visited++;
+	if (key >= query->key_min && key <= query->key_max &&
+	    !strcmp(strchr(strbuf, ' ') + 1, query->word)) {
+		query->num_matches++;
+	}
+	return 0;
+}
+
+int test_segments() {
+	objectlog_t log;
+	objectlog_segments_t segs;
+	objectlog_segment_t segments[32];
+
+	assert(!objectlog_setup(&log));
+	objectlog_segments_init(&segs, &log, segments, ARRAY_SIZE(segments), 1024,
+				segment_extract, NULL);
+	for (int i = 0; i < 3000; i++) {
+		char strbuf[64];
+		int len;
+
+		/* Words change slowly, thus most segments only contain a few */
+		len = snprintf(strbuf, sizeof(strbuf), "%d %s", i,
+			       segment_words[(i / 150 + rand() % 2) % ARRAY_SIZE(segment_words)]);
+		assert(!objectlog_write_object(&log, strbuf, len));
+	}
+
+	for (int i = 0; i < 20; i++) {
+		segment_query_t query = { 0 }, expected = { 0 };
+		objectlog_iterator_t iter;
+		uint64_t token;
+
+		query.key_min = 3000 - rand() % log.num_entries;
+		query.key_max = query.key_min + rand() % 300;
+		query.word = segment_words[rand() % ARRAY_SIZE(segment_words)];
+		expected = query;
+		token = objectlog_segment_hash(query.word, strlen(query.word));
+
+		assert(!objectlog_segment_scan(&segs, query.key_min, query.key_max, &token,
+					       segment_visit, &query));
+		objectlog_iterator(&log, 0, &iter);
+		for (unsigned int idx = 0; idx < log.num_entries; idx++) {
+			segment_visit(&log, &iter, &expected);
+			objectlog_next_entry(&log, &iter);
+		}
+		assert(query.num_matches == expected.num_matches);
+		assert(query.num_visited <= expected.num_visited);
+	}
+	objectlog_segments_release(&segs);
+
+	return 0;
+}
+
+int test_streaming() {
+	static uint8_t streambuf[4096];
+	nt_stream_t stream;
+	size_t offset = 0;
+	objectlog_t log;
+
+	/* Pieces with gaps in between, untouched gap bytes must stay zero */
+	memset(streambuf, 0, sizeof(streambuf));
+	memset(cmpbuf, 0, sizeof(streambuf));
+	random_bytes(randombuf, sizeof(streambuf));
+	nt_stream_init(&stream);
+	while (offset < sizeof(streambuf)) {
+		size_t len = rand() % 200;
+
+		if (len > sizeof(streambuf) - offset) {
+			len = sizeof(streambuf) - offset;
+		}
+		nt_stream_write(&stream, streambuf + offset, randombuf + offset, len);
+		memcpy(cmpbuf + offset, randombuf + offset, len);
+		offset += len + rand() % 3;
+	}
+	nt_stream_flush(&stream);
+	nt_fence();
+	assert(!memcmp(streambuf, cmpbuf, sizeof(streambuf)));
+
+	assert(!objectlog_setup(&log));
+	objectlog_set_streaming_threshold(&log, 256);
+	for (int i = 0; i < 3000; i++) {
+		size_t len = rand() % 1000 + 1;
+		objectlog_iterator_t iter;
+
+		random_bytes(randombuf, len);
+		if (objectlog_write_object(&log, randombuf, len)) {
+			continue;
+		}
+		objectlog_iterator(&log, log.num_entries - 1, &iter);
+		assert(read_object(&log, &iter, (char *)cmpbuf, sizeof(cmpbuf)) == len);
+		assert(!memcmp(cmpbuf, randombuf, len));
+	}
+
+	return 0;
+}
+
 int main() {
 	unsigned long seed = time(NULL);
 //	seed = 1622589983;
 	printf("Seed: %lu\n", seed);
 	srand(seed);
 
+	test_hugepage();
 	for (int i = 0; i < 100; i++) {
 		test_multiring();
 		test_objectlog();
+		test_channels();
+		test_persist();
+		test_regions();
+		test_rollup();
+		test_keyindex();
+		test_fd();
+		test_parallel();
+		test_shards();
+		test_mirror();
+		test_segments();
+		test_streaming();
 	}
 //	return 0;
 	return 0;
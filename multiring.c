@@ -1,17 +1,34 @@
 #include <string.h>
 
 #include "multiring.h"
+#include "nt_copy.h"
 
 #define ALIGN_UP(x, align) ((x) + ((align) - (x) % (align)))
 
-int multiring_init(multiring_t *multiring, const scatter_object_t *storage) {
+static scatter_size_t storage_list_offset(unsigned int max_storage) {
+	scatter_size_t storage_list_size = max_storage * sizeof(scatter_object_t) +
+					   max_storage * sizeof(unsigned int);
+
+	return ALIGN_UP(storage_list_size, 8);
+}
+
+/**
+ * Initialize multiring with spare scatter list slots
+ * Reserves @num_reserve additional scatter list slots for regions added at
+ * runtime through multiring_insert_region.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int multiring_init_reserve(multiring_t *multiring, const scatter_object_t *storage,
+			   unsigned int num_reserve) {
 	const scatter_object_t *sc_entry = storage;
 	unsigned int sc_max_entry_idx = 0;
 	scatter_object_t *sc_list_copy;
 	unsigned int num_storage_area = 0;
-	scatter_size_t storage_list_size;
+	unsigned int max_storage;
+	unsigned int idx;
 	scatter_size_t storage_size = 0;
-	scatter_size_t storage_list_offset;
+	scatter_size_t list_offset;
 
 	/*
 	 * Determine three parameters:
@@ -33,24 +50,32 @@ int multiring_init(multiring_t *multiring, const scatter_object_t *storage) {
 	}
 
 	multiring->num_storage = num_storage_area;
-	storage_list_size = (num_storage_area + 1) * sizeof(scatter_object_t);
-	storage_list_offset = ALIGN_UP(storage_list_size, 8);
+	max_storage = num_storage_area + num_reserve;
+	multiring->max_storage = max_storage;
+	list_offset = storage_list_offset(max_storage);
 
 	/* Ensure largest scatterlist entry can store a copy of the scatter list */
-	if (storage[sc_max_entry_idx].len <= storage_list_offset) {
+	if (storage[sc_max_entry_idx].len <= list_offset) {
 		return -1;
 	}
 
-	/* Create copy of the scatter list */
+	/* Create copy of the scatter list, unused slots have zero length */
 	sc_list_copy = storage[sc_max_entry_idx].ptr;
-	memcpy(sc_list_copy, storage, storage_list_size);
+	memcpy(sc_list_copy, storage, num_storage_area * sizeof(scatter_object_t));
+	memset(sc_list_copy + num_storage_area, 0, num_reserve * sizeof(scatter_object_t));
 	sc_list_copy[sc_max_entry_idx].ptr =
-		((uint8_t*)sc_list_copy[sc_max_entry_idx].ptr) + storage_list_offset;
-	sc_list_copy[sc_max_entry_idx].len -= storage_list_offset;
-	storage_size -= storage_list_offset;
+		((uint8_t*)sc_list_copy[sc_max_entry_idx].ptr) + list_offset;
+	sc_list_copy[sc_max_entry_idx].len -= list_offset;
+	storage_size -= list_offset;
+	/* Link regions into a ring in scatter list order */
+	multiring->next_ring = (unsigned int *)(sc_list_copy + max_storage);
+	for (idx = 0; idx < num_storage_area; idx++) {
+		multiring->next_ring[idx] = (idx + 1) % num_storage_area;
+	}
 	/* Point storeage to scatter list copy */
 	multiring->storage = sc_list_copy;
 	multiring->size = storage_size;
+	multiring->mirrored = false;
 
 	/* Set pointers to start of storage */
 	multiring->ptr_read.storage = sc_list_copy;
@@ -60,14 +85,128 @@ int multiring_init(multiring_t *multiring, const scatter_object_t *storage) {
 	return 0;
 }
 
-void multiring_next_ring(multiring_t *multiring, multiring_ptr_t *ptr) {
-	const scatter_object_t *storage = ptr->storage;
+/**
+ * Initialize multiring over single double mapped region @ring
+ * The @ring->len bytes following @ring->ptr must alias the region itself.
+ * Data is never split at the end of the region. The scatter list copy is
+ * placed in @meta instead of the region.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int multiring_init_mirrored(multiring_t *multiring, const scatter_object_t *ring,
+			    void *meta, scatter_size_t meta_len) {
+	scatter_object_t *sc_list_copy = meta;
+
+	if (!ring->len || meta_len < storage_list_offset(1)) {
+		return -1;
+	}
+
+	sc_list_copy[0] = *ring;
+	multiring->next_ring = (unsigned int *)(sc_list_copy + 1);
+	multiring->next_ring[0] = 0;
+	multiring->num_storage = 1;
+	multiring->max_storage = 1;
+	multiring->storage = sc_list_copy;
+	multiring->size = ring->len;
+	multiring->mirrored = true;
+
+	multiring->ptr_read.storage = sc_list_copy;
+	multiring->ptr_read.offset = 0;
+	multiring->ptr_write.storage = sc_list_copy;
+	multiring->ptr_write.offset = 0;
+	return 0;
+}
+
+int multiring_init(multiring_t *multiring, const scatter_object_t *storage) {
+	return multiring_init_reserve(multiring, storage, 0);
+}
+
+/**
+ * Find region starting at @ptr
+ *
+ * @returns: non-NULL pointer to scatter list slot on success, NULL on failure
+ */
+const scatter_object_t *multiring_find_region(multiring_t *multiring, const void *ptr) {
+	unsigned int idx;
+
+	for (idx = 0; idx < multiring->max_storage; idx++) {
+		if (multiring->storage[idx].len && multiring->storage[idx].ptr == ptr) {
+			return &multiring->storage[idx];
+		}
+	}
+
+	return NULL;
+}
 
-	storage++;
-	if (!storage->len) {
-		storage = multiring->storage;
+/**
+ * Link @region into ring directly after region @after
+ * The caller is responsible for ensuring that no data is stored across the
+ * end of @after.
+ *
+ * @returns: non-NULL pointer to scatter list slot on success, NULL on failure
+ */
+const scatter_object_t *multiring_insert_region(multiring_t *multiring,
+						const scatter_object_t *after,
+						const scatter_object_t *region) {
+	/* Cast to non-const, scatter list copy is owned by multiring */
+	scatter_object_t *slots = (scatter_object_t *)multiring->storage;
+	unsigned int after_idx = after - multiring->storage;
+	unsigned int idx;
+
+	if (!region->len || multiring->mirrored) {
+		return NULL;
 	}
-	ptr->storage = storage;
+
+	for (idx = 0; idx < multiring->max_storage; idx++) {
+		if (!slots[idx].len) {
+			break;
+		}
+	}
+	if (idx >= multiring->max_storage) {
+		return NULL;
+	}
+
+	slots[idx] = *region;
+	multiring->next_ring[idx] = multiring->next_ring[after_idx];
+	multiring->next_ring[after_idx] = idx;
+	multiring->num_storage++;
+	multiring->size += region->len;
+	return &slots[idx];
+}
+
+/**
+ * Unlink @region from ring
+ * The caller is responsible for ensuring that no data is stored in @region.
+ * The region holding the scatter list copy can not be removed.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int multiring_remove_region(multiring_t *multiring, const scatter_object_t *region) {
+	scatter_object_t *slots = (scatter_object_t *)multiring->storage;
+	unsigned int idx = region - multiring->storage;
+	unsigned int prev = idx;
+	scatter_size_t list_offset = storage_list_offset(multiring->max_storage);
+
+	if (!region->len || multiring->num_storage < 2 ||
+	    (uint8_t *)region->ptr == (uint8_t *)multiring->storage + list_offset) {
+		return -1;
+	}
+
+	while (multiring->next_ring[prev] != idx) {
+		prev = multiring->next_ring[prev];
+	}
+	multiring->next_ring[prev] = multiring->next_ring[idx];
+	multiring->num_storage--;
+	multiring->size -= region->len;
+	slots[idx].ptr = NULL;
+	slots[idx].len = 0;
+	return 0;
+}
+
+void multiring_next_ring(multiring_t *multiring, multiring_ptr_t *ptr) {
+	unsigned int idx = ptr->storage - multiring->storage;
+
+	ptr->storage = &multiring->storage[multiring->next_ring[idx]];
 	ptr->offset = 0;
 }
 
@@ -90,20 +229,26 @@ void multiring_advance(multiring_t *multiring, multiring_ptr_t *ptr,
 	*ptr = ring_ptr;
 }
 
-void multiring_write(multiring_t *multiring, const void *data, scatter_size_t len) {
+static void ring_write(multiring_t *multiring, const void *data, scatter_size_t len,
+		       nt_stream_t *stream) {
 	const uint8_t *data8 = data;
 
 	while (len) {
 		scatter_size_t write_size = len;
 		scatter_size_t space_avail =
-			multiring_available_contiguous(&multiring->ptr_write);
+			multiring_available_linear(multiring, &multiring->ptr_write);
+		uint8_t *dst;
 
 		if (write_size > space_avail) {
 			write_size = space_avail;
 		}
 
-		memcpy(((uint8_t*)multiring->ptr_write.storage->ptr) + multiring->ptr_write.offset,
-		       data8, write_size);
+		dst = ((uint8_t*)multiring->ptr_write.storage->ptr) + multiring->ptr_write.offset;
+		if (stream) {
+			nt_stream_write(stream, dst, data8, write_size);
+		} else {
+			memcpy(dst, data8, write_size);
+		}
 		multiring_advance_write(multiring, write_size);
 
 		len -= write_size;
@@ -111,13 +256,27 @@ void multiring_write(multiring_t *multiring, const void *data, scatter_size_t le
 	}
 }
 
+void multiring_write(multiring_t *multiring, const void *data, scatter_size_t len) {
+	ring_write(multiring, data, len, NULL);
+}
+
+/**
+ * Write bypassing the cache using non-temporal stores where supported
+ * Stores are combined in @stream, call nt_stream_flush and nt_fence before
+ * publishing the data.
+ */
+void multiring_write_streaming(multiring_t *multiring, nt_stream_t *stream,
+			       const void *data, scatter_size_t len) {
+	ring_write(multiring, data, len, stream);
+}
+
 void multiring_read(multiring_t *multiring, void *data, scatter_size_t len) {
 	uint8_t *data8 = data;
 
 	while (len) {
 		scatter_size_t read_size = len;
 		scatter_size_t space_avail =
-			multiring_available_contiguous(&multiring->ptr_read);
+			multiring_available_linear(multiring, &multiring->ptr_read);
 
 		if (read_size > space_avail) {
 			read_size = space_avail;
@@ -139,7 +298,7 @@ scatter_size_t multiring_num_wraps(multiring_t *multiring, scatter_size_t len) {
 
 	while (len) {
 		scatter_size_t chunk_size = len;
-		scatter_size_t space_avail = multiring_available_contiguous(&ptr);
+		scatter_size_t space_avail = multiring_available_linear(multiring, &ptr);
 
 		if (chunk_size > space_avail) {
 			chunk_size = space_avail;
@@ -160,7 +319,7 @@ void multiring_memset(multiring_t *multiring, uint8_t val, scatter_size_t len) {
 	while (len) {
 		scatter_size_t write_size = len;
 		scatter_size_t space_avail =
-			multiring_available_contiguous(&multiring->ptr_write);
+			multiring_available_linear(multiring, &multiring->ptr_write);
 
 		if (write_size > space_avail) {
 			write_size = space_avail;
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
+
+#include "nt_copy.h"
 #include "scatter.h"
 
 typedef struct {
@@ -10,16 +13,32 @@ typedef struct {
 typedef struct {
 	const scatter_object_t *storage;
 	unsigned int num_storage;
+	unsigned int max_storage;
+	/* Index of the region following each scatter list slot in the ring */
+	unsigned int *next_ring;
+	/* Single region whose end is mapped to its start again */
+	bool mirrored;
 	multiring_ptr_t ptr_read;
 	multiring_ptr_t ptr_write;
 	scatter_size_t size;
 } multiring_t;
 
 int multiring_init(multiring_t *multiring, const scatter_object_t *storage);
+int multiring_init_mirrored(multiring_t *multiring, const scatter_object_t *ring,
+			    void *meta, scatter_size_t meta_len);
+int multiring_init_reserve(multiring_t *multiring, const scatter_object_t *storage,
+			   unsigned int num_reserve);
+const scatter_object_t *multiring_insert_region(multiring_t *multiring,
+						const scatter_object_t *after,
+						const scatter_object_t *region);
+int multiring_remove_region(multiring_t *multiring, const scatter_object_t *region);
+const scatter_object_t *multiring_find_region(multiring_t *multiring, const void *ptr);
 void multiring_next_ring(multiring_t *multiring, multiring_ptr_t *ptr);
 void multiring_advance(multiring_t *multiring, multiring_ptr_t *ptr,
 		       scatter_size_t count);
 void multiring_write(multiring_t *multiring, const void *data, scatter_size_t len);
+void multiring_write_streaming(multiring_t *multiring, nt_stream_t *stream,
+			       const void *data, scatter_size_t len);
 void multiring_read(multiring_t *multiring, void *data, scatter_size_t len);
 scatter_size_t multiring_num_wraps(multiring_t *multiring, scatter_size_t len);
 void multiring_memset(multiring_t *multiring, uint8_t val, scatter_size_t len);
@@ -31,6 +50,19 @@ static inline scatter_size_t multiring_available_contiguous(const multiring_ptr_
 	return ptr->storage->len - ptr->offset;
 }
 
+/*
+ * Number of bytes that can be accessed linearly starting at @ptr. Unlike
+ * multiring_available_contiguous this covers the mirror of a double mapped
+ * region, thus the whole region is accessible from any offset.
+ */
+static inline scatter_size_t multiring_available_linear(const multiring_t *multiring,
+							const multiring_ptr_t *ptr) {
+	if (multiring->mirrored) {
+		return ptr->storage->len;
+	}
+	return multiring_available_contiguous(ptr);
+}
+
 static inline void multiring_advance_read(multiring_t *multiring,
 					   scatter_size_t count) {
 	multiring_advance(multiring, &multiring->ptr_read, count);
@@ -0,0 +1,158 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "nt_copy.h"
+
+/*
+ * Copy using non-temporal stores, bypassing the cache for the destination.
+ * Unaligned head and tail bytes are copied with regular stores. Stores
+ * are weakly ordered, nt_fence must be called before the data is
+ * published to other threads.
+ * Mixing regular and non-temporal stores on one cache line defeats the
+ * cache bypass. Writers producing many small pieces, such as fragment
+ * headers interleaved with payload, go through nt_stream_write instead. It
+ * assembles each destination line in a private buffer and emits complete
+ * lines with non-temporal stores only. Just the partial lines at either
+ * end of a span are written with regular stores.
+ */
+
+#if defined(__AVX__)
+#define NT_CHUNK 32
+
+static void nt_copy_chunks(uint8_t *dst, const uint8_t *src, size_t num_chunks) {
+	while (num_chunks--) {
+		_mm256_stream_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+		dst += NT_CHUNK;
+		src += NT_CHUNK;
+	}
+}
+#elif defined(__SSE2__)
+#define NT_CHUNK 16
+
+static void nt_copy_chunks(uint8_t *dst, const uint8_t *src, size_t num_chunks) {
+	while (num_chunks--) {
+		_mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+		dst += NT_CHUNK;
+		src += NT_CHUNK;
+	}
+}
+#elif defined(__aarch64__)
+#define NT_CHUNK 32
+
+/* NEON loads paired with STNP, the non-temporal store pair instruction */
+static void nt_copy_chunks(uint8_t *dst, const uint8_t *src, size_t num_chunks) {
+	while (num_chunks--) {
+		__asm__ volatile(
+			"ldp q0, q1, [%1]\n"
+			"stnp q0, q1, [%0]\n"
+			:
+			: "r" (dst), "r" (src)
+			: "v0", "v1", "memory");
+		dst += NT_CHUNK;
+		src += NT_CHUNK;
+	}
+}
+#endif
+
+#ifdef NT_CHUNK
+void nt_copy(void *dst, const void *src, size_t len) {
+	uint8_t *dst8 = dst;
+	const uint8_t *src8 = src;
+	size_t head = (NT_CHUNK - (uintptr_t)dst8 % NT_CHUNK) % NT_CHUNK;
+
+	if (len < head + NT_CHUNK) {
+		memcpy(dst8, src8, len);
+		return;
+	}
+
+	memcpy(dst8, src8, head);
+	dst8 += head;
+	src8 += head;
+	len -= head;
+
+	nt_copy_chunks(dst8, src8, len / NT_CHUNK);
+	dst8 += len - len % NT_CHUNK;
+	src8 += len - len % NT_CHUNK;
+	memcpy(dst8, src8, len % NT_CHUNK);
+}
+#else
+void nt_copy(void *dst, const void *src, size_t len) {
+	memcpy(dst, src, len);
+}
+#endif
+
+void nt_fence(void) {
+#if defined(__SSE2__) || defined(__AVX__)
+	_mm_sfence();
+#elif defined(__aarch64__)
+	__asm__ volatile("dmb ishst" ::: "memory");
+#endif
+}
+
+void nt_stream_init(nt_stream_t *stream) {
+	stream->dst = NULL;
+	stream->start = 0;
+	stream->end = 0;
+}
+
+/**
+ * Write back pending partial line using regular stores
+ *
+ */
+void nt_stream_flush(nt_stream_t *stream) {
+	if (!stream->dst) {
+		return;
+	}
+	memcpy(stream->dst + stream->start, stream->line + stream->start,
+	       stream->end - stream->start);
+	stream->dst = NULL;
+}
+
+/**
+ * Copy @len bytes to @dst, combining stores into complete cache lines
+ * Consecutive calls continuing at the end of the previous write fill the
+ * same line. nt_stream_flush must be called after the last write.
+ */
+void nt_stream_write(nt_stream_t *stream, void *dst, const void *src, size_t len) {
+	uint8_t *dst8 = dst;
+	const uint8_t *src8 = src;
+
+	while (len) {
+		uint8_t *line = (uint8_t *)((uintptr_t)dst8 & ~(uintptr_t)(NT_LINE_SIZE - 1));
+		size_t offset = dst8 - line;
+		size_t chunk = NT_LINE_SIZE - offset;
+
+		/* Pending line can only be completed by a write continuing it */
+		if (stream->dst && (stream->dst != line || stream->end != offset)) {
+			nt_stream_flush(stream);
+		}
+
+		if (!stream->dst && !offset && len >= NT_LINE_SIZE) {
+			/* Complete lines bypass the line buffer */
+			chunk = len - len % NT_LINE_SIZE;
+			nt_copy(dst8, src8, chunk);
+		} else {
+			if (chunk > len) {
+				chunk = len;
+			}
+			if (!stream->dst) {
+				stream->dst = line;
+				stream->start = offset;
+			}
+			memcpy(stream->line + offset, src8, chunk);
+			stream->end = offset + chunk;
+			if (!stream->start && stream->end == NT_LINE_SIZE) {
+				nt_copy(line, stream->line, NT_LINE_SIZE);
+				stream->dst = NULL;
+			}
+		}
+
+		dst8 += chunk;
+		src8 += chunk;
+		len -= chunk;
+	}
+}
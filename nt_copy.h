@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NT_LINE_SIZE 64
+
+/* Collects consecutive stores to one cache line until the line is complete */
+typedef struct {
+	uint8_t line[NT_LINE_SIZE];
+	/* Line aligned destination of @line, NULL if nothing is pending */
+	uint8_t *dst;
+	size_t start;
+	size_t end;
+} nt_stream_t;
+
+void nt_copy(void *dst, const void *src, size_t len);
+void nt_fence(void);
+void nt_stream_init(nt_stream_t *stream);
+void nt_stream_write(nt_stream_t *stream, void *dst, const void *src, size_t len);
+void nt_stream_flush(nt_stream_t *stream);
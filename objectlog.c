@@ -2,12 +2,8 @@
 #include <string.h>
 
 #include "objectlog.h"
-
-#define MAX_FRAGMENT_LEN 0x7f
-#define FRAGMENT_FINAL 0x80
-#define FRAGMENT_LEN(x) ((x) & MAX_FRAGMENT_LEN)
-
-#define DIV_ROUND_UP(x, y) (((x) + ((y) - 1)) / (y))
+#include "objectlog_priv.h"
+#include "nt_copy.h"
 
 static void get_next_entry(objectlog_t *log, multiring_ptr_t *offset) {
 	uint8_t fragment_hdr;
@@ -33,7 +29,28 @@ static scatter_size_t objectlog_space_between(objectlog_t *log,
 	return multiring_byte_delta(&log->multiring, first, second);
 }
 
+static void notify_append(objectlog_t *log, const multiring_ptr_t *entry) {
+	objectlog_observer_t *observer;
+
+	for (observer = log->observers; observer; observer = observer->next) {
+		if (observer->append) {
+			observer->append(log, entry, observer->priv);
+		}
+	}
+}
+
+static void notify_drop(objectlog_t *log, const multiring_ptr_t *entry) {
+	objectlog_observer_t *observer;
+
+	for (observer = log->observers; observer; observer = observer->next) {
+		if (observer->drop) {
+			observer->drop(log, entry, observer->priv);
+		}
+	}
+}
+
 static void drop_first_entry(objectlog_t *log) {
+	notify_drop(log, &log->ptr_first);
 	get_next_entry(log, &log->ptr_first);
 	log->num_entries--;
 }
@@ -42,35 +59,135 @@ static scatter_size_t objectlog_free_space(objectlog_t *log, multiring_ptr_t *fr
 	return objectlog_space_between(log, from, &log->ptr_first);
 }
 
-static void objectlog_write_fragment_hdr(objectlog_t *log, scatter_size_t len, bool final) {
+/*
+ * Regions can only be linked in after the region currently written to if
+ * no stored data crosses its end.
+ */
+static bool can_splice_region(objectlog_t *log) {
+	if (!log->num_entries ||
+	    log->ptr_first.storage != log->multiring.ptr_write.storage) {
+		return true;
+	}
+
+	return log->ptr_first.offset <= log->multiring.ptr_write.offset;
+}
+
+static int splice_pending_region(objectlog_t *log) {
+	if (!can_splice_region(log)) {
+		return 1;
+	}
+	if (!multiring_insert_region(&log->multiring, log->multiring.ptr_write.storage,
+				     &log->pending_region)) {
+		return -1;
+	}
+	log->pending_region.ptr = NULL;
+	log->pending_region.len = 0;
+	return 0;
+}
+
+static bool region_holds_data(objectlog_t *log, const scatter_object_t *region) {
+	multiring_ptr_t ptr = log->ptr_first;
+
+	if (!log->num_entries) {
+		return false;
+	}
+	if (region == log->multiring.ptr_write.storage) {
+		return true;
+	}
+	/* Either only the region written to or all regions hold data */
+	if (ptr.storage == log->multiring.ptr_write.storage) {
+		return ptr.offset > log->multiring.ptr_write.offset;
+	}
+
+	while (ptr.storage != log->multiring.ptr_write.storage) {
+		if (ptr.storage == region) {
+			return true;
+		}
+		multiring_next_ring(&log->multiring, &ptr);
+	}
+
+	return false;
+}
+
+static void objectlog_write_fragment_hdr(objectlog_t *log, scatter_size_t len, bool final,
+					 nt_stream_t *streaming) {
 	uint8_t hdr = FRAGMENT_LEN(len);
 
 	if (final) {
 		hdr |= FRAGMENT_FINAL;
 	}
-	multiring_write_one(&log->multiring, hdr);
+	if (streaming) {
+		multiring_write_streaming(&log->multiring, streaming, &hdr, 1);
+	} else {
+		multiring_write_one(&log->multiring, hdr);
+	}
 }
 
-static void objectlog_write_fragment_data(objectlog_t *log, const void *data, scatter_size_t len) {
-	multiring_write(&log->multiring, data, len);
+static void objectlog_write_fragment_data(objectlog_t *log, const void *data, scatter_size_t len,
+					  nt_stream_t *streaming) {
+	if (streaming) {
+		multiring_write_streaming(&log->multiring, streaming, data, len);
+	} else {
+		multiring_write(&log->multiring, data, len);
+	}
 }
 
-int objectlog_init_fragmented(objectlog_t *log, const scatter_object_t *storage) {
-	int err;
-
-	err = multiring_init(&log->multiring, storage);
-	if (err) {
-		return err;
-	}
+static void init_log(objectlog_t *log) {
 	/* Fill ring with zero-length fagments */
 	multiring_memset(&log->multiring, FRAGMENT_FINAL, log->multiring.size);
 
 	log->ptr_first = log->multiring.ptr_read;
 	log->ptr_last = log->multiring.ptr_read;
 	log->num_entries = 0;
+	log->observers = NULL;
+	log->pending_region.ptr = NULL;
+	log->pending_region.len = 0;
+	log->streaming_threshold = 0;
+}
+
+/**
+ * Initialize object log with spare scatter list slots
+ * Up to @num_reserve regions can be added at runtime using
+ * objectlog_add_region.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_init_fragmented_reserve(objectlog_t *log, const scatter_object_t *storage,
+				      unsigned int num_reserve) {
+	int err;
+
+	err = multiring_init_reserve(&log->multiring, storage, num_reserve);
+	if (err) {
+		return err;
+	}
+	init_log(log);
+	return 0;
+}
+
+/**
+ * Initialize object log over double mapped region @ring
+ * See multiring_init_mirrored for requirements on @ring and @meta. Objects
+ * and fragments are never split at the end of the region, thus objects of
+ * up to 127 bytes are always returned as a single fragment.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_init_mirrored(objectlog_t *log, const scatter_object_t *ring,
+			    void *meta, scatter_size_t meta_len) {
+	int err;
+
+	err = multiring_init_mirrored(&log->multiring, ring, meta, meta_len);
+	if (err) {
+		return err;
+	}
+	init_log(log);
 	return 0;
 }
 
+int objectlog_init_fragmented(objectlog_t *log, const scatter_object_t *storage) {
+	return objectlog_init_fragmented_reserve(log, storage, 0);
+}
+
 int objectlog_init(objectlog_t *log, void *storage, scatter_size_t size) {
 	scatter_object_t scatter_storage[] = {
 		{ .ptr = storage, .len = size },
@@ -80,35 +197,22 @@ int objectlog_init(objectlog_t *log, void *storage, scatter_size_t size) {
 	return objectlog_init_fragmented(log, scatter_storage);
 }
 
-/**
- * Write object from non-contiguous memory area to object log
- * Oftentimes data that needs to be stored is not available from a contiguous
- * memory region. This method accepts a list of (pointer, length) pairs and
- * constructs the object to be stored by iterating over it. In each iteration
- * @length bytes read from @pointer are appended to the object log.
+/*
+ * Evict objects until @len bytes of object data including fragment headers
+ * can be stored at the write pointer. Wraps might require additional
+ * headers, these are accounted for here.
  *
  * @returns: 0 on success, number of bytes missing for storage on failure
  */
-scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_object_t *scatter_list)
-{
-	const scatter_object_t *sc_list = scatter_list;
-	const uint8_t *data8;
-	scatter_size_t num_fragments;
-	scatter_size_t data_len = 0;
-	scatter_size_t total_len;
-	multiring_ptr_t new_last;
+scatter_size_t objectlog_make_room(objectlog_t *log, scatter_size_t len) {
+	scatter_size_t total_len = len;
 	scatter_size_t free_space;
-	multiring_ptr_t log_end = log->ptr_last;
-	scatter_size_t scatter_entry_offset = 0;
-	scatter_size_t fragment_offset = 0;
-	scatter_size_t fragment_len;
+	multiring_ptr_t log_end;
 
-	/* Calculate total length of all data in @scatter_list */
-	data_len = scatter_list_size(sc_list);
+	if (log->pending_region.len) {
+		splice_pending_region(log);
+	}
 
-	/* Calculate number of fragments required to store data */
-	num_fragments = DIV_ROUND_UP(data_len, MAX_FRAGMENT_LEN);
-	total_len = data_len + num_fragments;
 	/* FIXME: assume safe maximum for number of extra headers from wraps */
 	total_len += log->multiring.num_storage;
 	/* We can not store any messages exceeding size of this buffer */
@@ -117,6 +221,7 @@ scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_
 	}
 
 	/* Get number of bytes not in use at the moment */
+	log_end = log->ptr_last;
 	get_next_entry(log, &log_end);
 	free_space = objectlog_free_space(log, &log_end);
 	/* Delete entries from start of list until object fits */
@@ -129,7 +234,10 @@ scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_
 		if (!multiring_ptr_cmp(&log->ptr_first, &log->ptr_last)) {
 			multiring_ptr_t init_ptr;
 
-			init_ptr.storage = log->multiring.storage;
+			if (log->num_entries) {
+				notify_drop(log, &log->ptr_first);
+			}
+			init_ptr.storage = log->multiring.ptr_write.storage;
 			init_ptr.offset = 0;
 			log->ptr_first = init_ptr;
 			log->ptr_last = init_ptr;
@@ -141,21 +249,100 @@ scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_
 		free_space = objectlog_free_space(log, &log_end);
 	}
 
+	return 0;
+}
+
+/* Make object written starting at @new_last the last object of the log */
+void objectlog_commit_object(objectlog_t *log, const multiring_ptr_t *new_last) {
+	log->ptr_last = *new_last;
+	log->num_entries++;
+	notify_append(log, new_last);
+}
+
+/*
+ * Roll back write pointer to @start after an object could not be written.
+ * An empty log requires a terminating entry at the write pointer.
+ */
+void objectlog_abort_object(objectlog_t *log, const multiring_ptr_t *start) {
+	log->multiring.ptr_write = *start;
+	if (!log->num_entries) {
+		multiring_write_one(&log->multiring, FRAGMENT_FINAL);
+		log->multiring.ptr_write = *start;
+		log->ptr_first = *start;
+		log->ptr_last = *start;
+	}
+}
+
+/**
+ * Write object from non-contiguous memory area to object log
+ * Works like objectlog_write_scattered_object but stores @prefix_len bytes
+ * from @prefix in front of the data. The prefix, e.g. a tag, is kept in
+ * fragments of its own, readers can skip it fragment by fragment. A
+ * @prefix_len of 0 writes no prefix.
+ *
+ * @returns: 0 on success, number of bytes missing for storage on failure
+ */
+scatter_size_t objectlog_write_prefixed_object(objectlog_t *log, const void *prefix,
+					       scatter_size_t prefix_len,
+					       const scatter_object_t *scatter_list)
+{
+	/* Cast to non-const for compatibility, still never written */
+	const scatter_object_t prefix_entry = { .ptr = (void *)prefix, .len = prefix_len };
+	const scatter_object_t *sc_list;
+	scatter_size_t split = prefix_len;
+	const uint8_t *data8;
+	scatter_size_t num_fragments;
+	scatter_size_t data_len = 0;
+	scatter_size_t object_len;
+	scatter_size_t missing;
+	nt_stream_t stream;
+	nt_stream_t *streaming = NULL;
+	multiring_ptr_t new_last;
+	scatter_size_t scatter_entry_offset = 0;
+	scatter_size_t fragment_offset = 0;
+	scatter_size_t fragment_len;
+
+	/* Calculate total length of prefix and all data in @scatter_list */
+	data_len = prefix_len + scatter_list_size(scatter_list);
+	object_len = data_len;
+
+	/* Calculate number of fragments required to store data */
+	num_fragments = DIV_ROUND_UP(data_len, MAX_FRAGMENT_LEN);
+	/* Splitting the object requires at most one extra fragment */
+	if (split && split < data_len) {
+		num_fragments++;
+	}
+	missing = objectlog_make_room(log, data_len + num_fragments);
+	if (missing) {
+		return missing;
+	}
+	/* Large objects bypass the cache, headers and payload in one stream */
+	if (log->streaming_threshold && object_len >= log->streaming_threshold) {
+		nt_stream_init(&stream);
+		streaming = &stream;
+	}
+
 	/* Store start of object header */
 	new_last = log->multiring.ptr_write;
 
 	/* Write object as @num_fragments fragments */
-	sc_list = scatter_list;
+	sc_list = prefix_len ? &prefix_entry : scatter_list;
 	data8 = sc_list->ptr;
 	while(sc_list->len) {
 		scatter_size_t write_len = data_len;
 
 		/* Calculate maximum permissible size for this fragment */
 		if (!fragment_offset) {
+			scatter_size_t object_offset = object_len - data_len;
+
 			fragment_len = MAX_FRAGMENT_LEN;
+			/* Ensure fragment does not cross the split point */
+			if (object_offset < split && fragment_len > split - object_offset) {
+				fragment_len = split - object_offset;
+			}
 			/* Ensure fragment does not wrap in ring buffer */
-			if (fragment_len > multiring_available_contiguous(&log->multiring.ptr_write) - 1) {
-				fragment_len = multiring_available_contiguous(&log->multiring.ptr_write) - 1;
+			if (fragment_len > multiring_available_linear(&log->multiring, &log->multiring.ptr_write) - 1) {
+				fragment_len = multiring_available_linear(&log->multiring, &log->multiring.ptr_write) - 1;
 			}
 		}
 
@@ -166,7 +353,7 @@ scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_
 
 		/* Write fragment header whenever we start a new fragment */
 		if (!fragment_offset) {
-			objectlog_write_fragment_hdr(log, write_len, data_len == write_len);
+			objectlog_write_fragment_hdr(log, write_len, data_len == write_len, streaming);
 		}
 
 		/* Limit length of this write to scatter entry length */
@@ -174,7 +361,7 @@ scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_
 			write_len = sc_list->len - scatter_entry_offset;
 		}
 
-		objectlog_write_fragment_data(log, data8, write_len);
+		objectlog_write_fragment_data(log, data8, write_len, streaming);
 		data8 += write_len;
 		data_len -= write_len;
 		scatter_entry_offset += write_len;
@@ -182,7 +369,7 @@ scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_
 
 		/* Switch to next scatter entry if there is no more data in current one */
 		if (scatter_entry_offset >= sc_list->len) {
-			sc_list++;
+			sc_list = sc_list == &prefix_entry ? scatter_list : sc_list + 1;
 			data8 = sc_list->ptr;
 			scatter_entry_offset = 0;
 		}
@@ -191,12 +378,28 @@ scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_
 			fragment_offset = 0;
 		}
 	}
-	log->ptr_last = new_last;
-	log->num_entries++;
+	if (streaming) {
+		nt_stream_flush(streaming);
+		nt_fence();
+	}
+	objectlog_commit_object(log, &new_last);
 
 	return 0;
 }
 
+/**
+ * Write object from non-contiguous memory area to object log
+ * Oftentimes data that needs to be stored is not available from a contiguous
+ * memory region. This method accepts a list of (pointer, length) pairs and
+ * constructs the object to be stored by iterating over it. In each iteration
+ * @length bytes read from @pointer are appended to the object log.
+ *
+ * @returns: 0 on success, number of bytes missing for storage on failure
+ */
+scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_object_t *scatter_list) {
+	return objectlog_write_prefixed_object(log, NULL, 0, scatter_list);
+}
+
 scatter_size_t objectlog_write_object(objectlog_t *log, const void *data, scatter_size_t len) {
 	scatter_object_t scatter_list[] = {
 		/* Cast to non-const for compatibility, still never written */
@@ -286,6 +489,18 @@ void objectlog_next(objectlog_t *log, objectlog_iterator_t *iterator) {
 	*iterator = log->multiring.ptr_read;
 }
 
+/**
+ * Advance iterator from start of an object to start of the following object
+ *
+ */
+void objectlog_next_entry(objectlog_t *log, objectlog_iterator_t *iterator) {
+	if (objectlog_iterator_is_err(iterator)) {
+		return;
+	}
+
+	get_next_entry(log, iterator);
+}
+
 /**
  * Get size of object at index @object_idx
  *
@@ -312,3 +527,155 @@ objectlog_ssize_t objectlog_get_object_size(objectlog_t *log, int object_idx) {
 
 	return len;
 }
+
+/**
+ * Copy up to @len bytes starting at @offset from object at @iterator
+ *
+ * @returns: number of bytes copied
+ */
+scatter_size_t objectlog_read_object(objectlog_t *log, const objectlog_iterator_t *iterator,
+				     scatter_size_t offset, void *data, scatter_size_t len) {
+	objectlog_iterator_t iter = *iterator;
+	uint8_t *data8 = data;
+	scatter_size_t read_len = 0;
+
+	while (len && !objectlog_iterator_is_err(&iter)) {
+		uint8_t fragment_size;
+		const uint8_t *fragment = objectlog_get_fragment(log, &iter, &fragment_size);
+		scatter_size_t copy_len;
+
+		if (offset >= fragment_size) {
+			offset -= fragment_size;
+			objectlog_next(log, &iter);
+			continue;
+		}
+
+		copy_len = fragment_size - offset;
+		if (copy_len > len) {
+			copy_len = len;
+		}
+		memcpy(data8, fragment + offset, copy_len);
+		data8 += copy_len;
+		read_len += copy_len;
+		len -= copy_len;
+		offset = 0;
+		objectlog_next(log, &iter);
+	}
+
+	return read_len;
+}
+
+/**
+ * Evict oldest object from log
+ *
+ */
+void objectlog_drop_first(objectlog_t *log) {
+	if (!log->num_entries) {
+		return;
+	}
+
+	/*
+	 * Special case:
+	 * Dropping the only object left places an empty terminating entry at
+	 * the write pointer, matching the state of a freshly initialized log
+	 */
+	if (log->num_entries == 1) {
+		multiring_ptr_t log_end = log->multiring.ptr_write;
+
+		notify_drop(log, &log->ptr_first);
+		multiring_write_one(&log->multiring, FRAGMENT_FINAL);
+		log->multiring.ptr_write = log_end;
+		log->ptr_first = log_end;
+		log->ptr_last = log_end;
+		log->num_entries = 0;
+		return;
+	}
+
+	drop_first_entry(log);
+}
+
+/**
+ * Use non-temporal stores for objects of at least @threshold bytes
+ * Storing large objects then does not evict the working set of the writer
+ * from the CPU caches. Fragment headers and payload are combined into whole
+ * cache lines, only the partial lines at either end of an object are written
+ * through the cache. A @threshold of 0 disables non-temporal stores.
+ */
+void objectlog_set_streaming_threshold(objectlog_t *log, scatter_size_t threshold) {
+	log->streaming_threshold = threshold;
+}
+
+/**
+ * Register @observer for append and eviction notifications
+ * @observer must stay valid until removed from the log again.
+ */
+void objectlog_add_observer(objectlog_t *log, objectlog_observer_t *observer) {
+	observer->next = log->observers;
+	log->observers = observer;
+}
+
+void objectlog_remove_observer(objectlog_t *log, objectlog_observer_t *observer) {
+	objectlog_observer_t **link = &log->observers;
+
+	while (*link) {
+		if (*link == observer) {
+			*link = observer->next;
+			return;
+		}
+		link = &(*link)->next;
+	}
+}
+
+/**
+ * Add storage region to log at runtime
+ * The region is linked into the ring right behind the write pointer. If
+ * stored data is in the way the region is spliced in on one of the following
+ * writes instead. Only a single region can be pending at any time.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_add_region(objectlog_t *log, void *storage, scatter_size_t size) {
+	if (!size || log->pending_region.len) {
+		return -1;
+	}
+
+	log->pending_region.ptr = storage;
+	log->pending_region.len = size;
+	if (splice_pending_region(log) < 0) {
+		log->pending_region.ptr = NULL;
+		log->pending_region.len = 0;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Remove storage region starting at @storage from log at runtime
+ * Objects stored in the region are evicted. Since the log is strictly
+ * ordered this includes all objects older than them. The region currently
+ * written to can not be removed, try again after further writes.
+ * Once this method returns successfully the region is no longer accessed.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_remove_region(objectlog_t *log, const void *storage) {
+	const scatter_object_t *region;
+
+	if (log->pending_region.len && log->pending_region.ptr == storage) {
+		log->pending_region.ptr = NULL;
+		log->pending_region.len = 0;
+		return 0;
+	}
+
+	region = multiring_find_region(&log->multiring, storage);
+	if (!region || region == log->multiring.ptr_write.storage ||
+	    log->multiring.num_storage < 2) {
+		return -1;
+	}
+
+	while (region_holds_data(log, region)) {
+		objectlog_drop_first(log);
+	}
+
+	return multiring_remove_region(&log->multiring, region);
+}
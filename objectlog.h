@@ -8,24 +8,59 @@
 
 typedef long objectlog_ssize_t;
 
-typedef struct {
+typedef multiring_ptr_t objectlog_iterator_t;
+
+struct objectlog;
+
+/*
+ * Observers are notified whenever an entry is added to or evicted from the
+ * log. They are owned by the caller and chained into a singly linked list,
+ * thus no allocation is required for registering them.
+ */
+typedef struct objectlog_observer {
+	struct objectlog_observer *next;
+	void (*append)(struct objectlog *log, const objectlog_iterator_t *entry, void *priv);
+	void (*drop)(struct objectlog *log, const objectlog_iterator_t *entry, void *priv);
+	void *priv;
+} objectlog_observer_t;
+
+typedef struct objectlog {
 	multiring_t multiring;
 	multiring_ptr_t ptr_first;
 	multiring_ptr_t ptr_last;
 	unsigned int num_entries;
+	objectlog_observer_t *observers;
+	/* Region waiting to be spliced into the ring at the next safe point */
+	scatter_object_t pending_region;
+	/* Minimum object size for non-temporal payload stores, 0 disables */
+	scatter_size_t streaming_threshold;
 } objectlog_t;
 
-typedef multiring_ptr_t objectlog_iterator_t;
-
 int objectlog_init(objectlog_t *log, void *storage, scatter_size_t size);
 int objectlog_init_fragmented(objectlog_t *log, const scatter_object_t *storage);
+int objectlog_init_fragmented_reserve(objectlog_t *log, const scatter_object_t *storage,
+				      unsigned int num_reserve);
+int objectlog_init_mirrored(objectlog_t *log, const scatter_object_t *ring,
+			    void *meta, scatter_size_t meta_len);
+int objectlog_add_region(objectlog_t *log, void *storage, scatter_size_t size);
+int objectlog_remove_region(objectlog_t *log, const void *storage);
 scatter_size_t objectlog_write_object(objectlog_t *log, const void *data, scatter_size_t len);
 scatter_size_t objectlog_write_scattered_object(objectlog_t *log, const scatter_object_t *scatter_list);
 scatter_size_t objectlog_write_string(objectlog_t *log, const char *str);
+scatter_size_t objectlog_write_prefixed_object(objectlog_t *log, const void *prefix,
+					       scatter_size_t prefix_len,
+					       const scatter_object_t *scatter_list);
+void objectlog_drop_first(objectlog_t *log);
+void objectlog_set_streaming_threshold(objectlog_t *log, scatter_size_t threshold);
+void objectlog_add_observer(objectlog_t *log, objectlog_observer_t *observer);
+void objectlog_remove_observer(objectlog_t *log, objectlog_observer_t *observer);
 void objectlog_iterator(objectlog_t *log, int object_idx, objectlog_iterator_t *iterator);
 const void *objectlog_get_fragment(objectlog_t *log, objectlog_iterator_t *iterator, uint8_t *len);
 void objectlog_next(objectlog_t *log, objectlog_iterator_t *iterator);
+void objectlog_next_entry(objectlog_t *log, objectlog_iterator_t *iterator);
 objectlog_ssize_t objectlog_get_object_size(objectlog_t *log, int object_idx);
+scatter_size_t objectlog_read_object(objectlog_t *log, const objectlog_iterator_t *iterator,
+				     scatter_size_t offset, void *data, scatter_size_t len);
 
 static inline int objectlog_iterator_is_err(objectlog_iterator_t *iterator) {
 	return !iterator->storage;
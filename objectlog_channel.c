@@ -0,0 +1,182 @@
+#include <stddef.h>
+
+#include "objectlog_channel.h"
+
+/*
+ * Channel entries are regular log entries prefixed by a single byte channel
+ * tag. The tag is always stored in a fragment of its own. Thus, readers of
+ * a channel can simply skip the tag fragments and never see it as part of
+ * the payload.
+ */
+
+/* Locate tag of @entry, leaves @iter pointing to the tag fragment */
+static uint8_t *channel_tag(objectlog_t *log, objectlog_iterator_t *iter) {
+	while (!objectlog_iterator_is_err(iter)) {
+		uint8_t len;
+		const void *fragment = objectlog_get_fragment(log, iter, &len);
+
+		/* Cast to non-const, tag is owned by this module */
+		if (len) {
+			return (uint8_t *)fragment;
+		}
+		objectlog_next(log, iter);
+	}
+
+	return NULL;
+}
+
+static objectlog_iterator_t *channel_entry(objectlog_channel_t *channel, unsigned int idx) {
+	return &channel->index[(channel->first + idx) % channel->size];
+}
+
+static void channel_pop(objectlog_channel_t *channel) {
+	channel->first = (channel->first + 1) % channel->size;
+	channel->num_entries--;
+}
+
+static void channel_push(objectlog_channel_t *channel, const objectlog_iterator_t *entry) {
+	*channel_entry(channel, channel->num_entries) = *entry;
+	channel->num_entries++;
+}
+
+static void channels_drop(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_channels_t *chans = priv;
+	objectlog_channel_t *channel;
+	objectlog_iterator_t iter = *entry;
+	uint8_t *tag;
+
+	tag = channel_tag(log, &iter);
+	/* Ignore retired and foreign entries */
+	if (!tag || *tag >= chans->num_channels) {
+		return;
+	}
+
+	channel = &chans->channels[*tag];
+	if (!channel->num_entries ||
+	    multiring_ptr_cmp(channel_entry(channel, 0), (multiring_ptr_t *)entry)) {
+		return;
+	}
+	channel_pop(channel);
+}
+
+/* Remove oldest entry from @channel, its storage is reclaimed in log order */
+static void channel_retire_first(objectlog_channels_t *chans, objectlog_channel_t *channel) {
+	objectlog_iterator_t iter = *channel_entry(channel, 0);
+	uint8_t *tag;
+
+	tag = channel_tag(chans->log, &iter);
+	if (tag) {
+		*tag = OBJECTLOG_CHANNEL_RETIRED;
+	}
+	channel_pop(channel);
+}
+
+void objectlog_channel_init(objectlog_channel_t *channel, objectlog_iterator_t *index,
+			    unsigned int size) {
+	channel->index = index;
+	channel->size = size;
+	channel->first = 0;
+	channel->num_entries = 0;
+}
+
+/**
+ * Attach channel index to object log
+ * Each of the @num_channels channels indexes up to its size entries. Once
+ * a channel is full its oldest entry is retired from the index to make
+ * room for a new one. Retired entries keep their storage until it is
+ * reclaimed in log order, storage is shared by all channels and evicted
+ * oldest first regardless of the channel.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_channels_init(objectlog_channels_t *chans, objectlog_t *log,
+			    objectlog_channel_t *channels, unsigned int num_channels) {
+	if (num_channels > OBJECTLOG_CHANNEL_RETIRED) {
+		return -1;
+	}
+
+	chans->log = log;
+	chans->channels = channels;
+	chans->num_channels = num_channels;
+	chans->observer.append = NULL;
+	chans->observer.drop = channels_drop;
+	chans->observer.priv = chans;
+	objectlog_add_observer(log, &chans->observer);
+	return 0;
+}
+
+void objectlog_channels_release(objectlog_channels_t *chans) {
+	objectlog_remove_observer(chans->log, &chans->observer);
+}
+
+/**
+ * Write object from non-contiguous memory area to channel @id
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_channel_write_scattered_object(objectlog_channels_t *chans,
+					     objectlog_channel_id_t id,
+					     const scatter_object_t *scatter_list) {
+	objectlog_channel_t *channel;
+
+	if (id >= chans->num_channels) {
+		return -1;
+	}
+	channel = &chans->channels[id];
+	if (!channel->size) {
+		return -1;
+	}
+
+	if (objectlog_write_prefixed_object(chans->log, &id, sizeof(id), scatter_list)) {
+		return -1;
+	}
+
+	/* Make room in channel index, storage is left to the log */
+	if (channel->num_entries >= channel->size) {
+		channel_retire_first(chans, channel);
+	}
+	channel_push(channel, &chans->log->ptr_last);
+	return 0;
+}
+
+int objectlog_channel_write_object(objectlog_channels_t *chans, objectlog_channel_id_t id,
+				   const void *data, scatter_size_t len) {
+	scatter_object_t scatter_list[] = {
+		/* Cast to non-const for compatibility, still never written */
+		{ .ptr = (void *)data, .len = len },
+		{ .len = 0 }
+	};
+
+	return objectlog_channel_write_scattered_object(chans, id, scatter_list);
+}
+
+/**
+ * Obtain iterator for object at index @object_idx within channel @id
+ * Negative indices count from last to first object. The iterator points
+ * to the first payload fragment, objects without payload yield an error
+ * iterator.
+ *
+ */
+void objectlog_channel_iterator(objectlog_channels_t *chans, objectlog_channel_id_t id,
+				int object_idx, objectlog_iterator_t *iterator) {
+	objectlog_channel_t *channel;
+
+	iterator->storage = NULL;
+	if (id >= chans->num_channels) {
+		return;
+	}
+	channel = &chans->channels[id];
+
+	if (object_idx < 0) {
+		object_idx += (int)channel->num_entries;
+	}
+	if (object_idx < 0 || object_idx >= (int)channel->num_entries) {
+		return;
+	}
+
+	*iterator = *channel_entry(channel, object_idx);
+	/* Skip tag fragment */
+	if (channel_tag(chans->log, iterator)) {
+		objectlog_next(chans->log, iterator);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "objectlog.h"
+#include "scatter.h"
+
+/* Tag of entries retired from their channel but still occupying the log */
+#define OBJECTLOG_CHANNEL_RETIRED 0xff
+
+typedef uint8_t objectlog_channel_id_t;
+
+typedef struct {
+	objectlog_iterator_t *index;
+	unsigned int size;
+	unsigned int first;
+	unsigned int num_entries;
+} objectlog_channel_t;
+
+typedef struct {
+	objectlog_t *log;
+	objectlog_channel_t *channels;
+	unsigned int num_channels;
+	objectlog_observer_t observer;
+} objectlog_channels_t;
+
+void objectlog_channel_init(objectlog_channel_t *channel, objectlog_iterator_t *index,
+			    unsigned int size);
+int objectlog_channels_init(objectlog_channels_t *chans, objectlog_t *log,
+			    objectlog_channel_t *channels, unsigned int num_channels);
+void objectlog_channels_release(objectlog_channels_t *chans);
+int objectlog_channel_write_scattered_object(objectlog_channels_t *chans,
+					     objectlog_channel_id_t id,
+					     const scatter_object_t *scatter_list);
+int objectlog_channel_write_object(objectlog_channels_t *chans, objectlog_channel_id_t id,
+				   const void *data, scatter_size_t len);
+void objectlog_channel_iterator(objectlog_channels_t *chans, objectlog_channel_id_t id,
+				int object_idx, objectlog_iterator_t *iterator);
+
+static inline unsigned int objectlog_channel_num_entries(objectlog_channels_t *chans,
+							  objectlog_channel_id_t id) {
+	if (id >= chans->num_channels) {
+		return 0;
+	}
+	return chans->channels[id].num_entries;
+}
@@ -0,0 +1,198 @@
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+
+#include "objectlog_fd.h"
+#include "objectlog_priv.h"
+
+#define FD_MAX_IOV 64
+
+/*
+ * Fragment headers for the maximum object size are laid out in the ring
+ * first. Data is then read directly into the fragment payload areas. Once
+ * the actual number of bytes read is known the header of the last fragment
+ * holding data is fixed up to terminate the object.
+ * Room for the maximum object size is made before reading. Non-blocking
+ * descriptors are polled first, thus nothing is evicted for EAGAIN.
+ */
+
+typedef struct {
+	multiring_ptr_t ptr;
+	/* Bytes left in payload area of fragment at @ptr */
+	scatter_size_t fragment_left;
+} fd_cursor_t;
+
+static uint8_t *ring_byte(const multiring_ptr_t *ptr) {
+	return (uint8_t *)ptr->storage->ptr + ptr->offset;
+}
+
+/* Lay out fragment headers for @len bytes of payload starting at write pointer */
+static void fd_layout_fragments(objectlog_t *log, scatter_size_t len) {
+	while (len) {
+		scatter_size_t fragment_len = MAX_FRAGMENT_LEN;
+
+		/* Ensure fragment does not wrap in ring buffer */
+		if (fragment_len > multiring_available_linear(&log->multiring, &log->multiring.ptr_write) - 1) {
+			fragment_len = multiring_available_linear(&log->multiring, &log->multiring.ptr_write) - 1;
+		}
+		if (fragment_len > len) {
+			fragment_len = len;
+		}
+
+		multiring_write_one(&log->multiring, FRAGMENT_LEN(fragment_len));
+		multiring_advance_write(&log->multiring, fragment_len);
+		len -= fragment_len;
+	}
+}
+
+/*
+ * Advance @cursor by @len payload bytes, recording the payload areas passed
+ * in @iov if non-NULL
+ *
+ * @returns: number of iovecs recorded
+ */
+static int fd_cursor_advance(objectlog_t *log, fd_cursor_t *cursor, scatter_size_t len,
+			     struct iovec *iov, int max_iov) {
+	int num_iov = 0;
+
+	while (len) {
+		scatter_size_t chunk_len;
+
+		if (!cursor->fragment_left) {
+			cursor->fragment_left = FRAGMENT_LEN(*ring_byte(&cursor->ptr));
+			multiring_advance(&log->multiring, &cursor->ptr, 1);
+			continue;
+		}
+
+		if (iov && num_iov >= max_iov) {
+			break;
+		}
+
+		chunk_len = cursor->fragment_left;
+		if (chunk_len > len) {
+			chunk_len = len;
+		}
+		if (iov) {
+			iov[num_iov].iov_base = ring_byte(&cursor->ptr);
+			iov[num_iov].iov_len = chunk_len;
+			num_iov++;
+		}
+		multiring_advance(&log->multiring, &cursor->ptr, chunk_len);
+		cursor->fragment_left -= chunk_len;
+		len -= chunk_len;
+	}
+
+	return num_iov;
+}
+
+/*
+ * Check whether non-blocking @fd has data or an error to report
+ *
+ * @returns: 1 if readv will not return EAGAIN, 0 if no data is available or
+ *	     end of file was reached, negative error code on failure
+ */
+static int fd_readable(int fd) {
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret;
+
+	do {
+		ret = poll(&pfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		return -errno;
+	}
+	if (pfd.revents & POLLNVAL) {
+		return -EBADF;
+	}
+
+	/* Hang up without POLLIN means end of file, errors are left to readv */
+	return !!(pfd.revents & (POLLIN | POLLERR));
+}
+
+/* Terminate object of @len bytes starting at @start, sets write pointer */
+static void fd_terminate_object(objectlog_t *log, const multiring_ptr_t *start,
+				scatter_size_t len) {
+	multiring_ptr_t ptr = *start;
+
+	while (1) {
+		uint8_t *hdr = ring_byte(&ptr);
+		scatter_size_t fragment_len = FRAGMENT_LEN(*hdr);
+
+		if (fragment_len && fragment_len >= len) {
+			*hdr = FRAGMENT_LEN(len) | FRAGMENT_FINAL;
+			multiring_advance(&log->multiring, &ptr, 1 + len);
+			break;
+		}
+		multiring_advance(&log->multiring, &ptr, 1 + fragment_len);
+		len -= fragment_len;
+	}
+
+	log->multiring.ptr_write = ptr;
+}
+
+/**
+ * Read object of up to @len bytes from file descriptor @fd
+ * Data is read directly into log storage without intermediate copies.
+ * Like read(2) a single read is issued, which may return fewer than @len
+ * bytes. All data read is stored as a single object.
+ * Room for @len bytes is made before reading, a short read thus evicts as
+ * many older objects as a full one. Pass OBJECTLOG_FD_NONBLOCK in @flags
+ * for non-blocking descriptors, they are polled first so nothing is evicted
+ * while no data is available. On blocking descriptors reaching end of file
+ * may evict objects without storing anything.
+ *
+ * @returns: number of bytes stored, 0 if no data was available,
+ *	     negative error code on failure
+ */
+objectlog_ssize_t objectlog_write_from_fd(objectlog_t *log, int fd, scatter_size_t len,
+					  unsigned int flags) {
+	struct iovec iov[FD_MAX_IOV];
+	multiring_ptr_t new_last;
+	fd_cursor_t cursor;
+	scatter_size_t read_len = 0;
+	ssize_t ret;
+	int num_iov;
+	int err = 0;
+
+	if (!len) {
+		return 0;
+	}
+	if (flags & OBJECTLOG_FD_NONBLOCK) {
+		err = fd_readable(fd);
+		if (err <= 0) {
+			return err;
+		}
+		err = 0;
+	}
+	if (objectlog_make_room(log, len + DIV_ROUND_UP(len, MAX_FRAGMENT_LEN))) {
+		return -ENOSPC;
+	}
+
+	new_last = log->multiring.ptr_write;
+	fd_layout_fragments(log, len);
+
+	cursor.ptr = new_last;
+	cursor.fragment_left = 0;
+	num_iov = fd_cursor_advance(log, &cursor, len, iov, FD_MAX_IOV);
+	do {
+		ret = readv(fd, iov, num_iov);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		err = -errno;
+	} else {
+		read_len = ret;
+	}
+
+	if (!read_len) {
+		objectlog_abort_object(log, &new_last);
+		/* Running out of data on non-blocking descriptors is no error */
+		if (err == -EAGAIN || err == -EWOULDBLOCK) {
+			return 0;
+		}
+		return err;
+	}
+
+	fd_terminate_object(log, &new_last, read_len);
+	objectlog_commit_object(log, &new_last);
+	return read_len;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "objectlog.h"
+
+/* Descriptor is non-blocking, poll it before making room */
+#define OBJECTLOG_FD_NONBLOCK 0x01
+
+objectlog_ssize_t objectlog_write_from_fd(objectlog_t *log, int fd, scatter_size_t len,
+					  unsigned int flags);
@@ -0,0 +1,151 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "objectlog_keyindex.h"
+
+/*
+ * Open addressing hash table with linear probing mapping keys to the newest
+ * object carrying them. Objects are evicted strictly in order, thus a slot
+ * is stale iff the sequence number of its object is below the number of
+ * objects dropped so far. Stale slots are never cleared on eviction, they
+ * are reused by later insertions instead.
+ */
+
+static uint64_t keyindex_hash(uint64_t key) {
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return key;
+}
+
+static bool keyindex_slot_is_live(objectlog_keyindex_t *index,
+				  const objectlog_keyindex_slot_t *slot) {
+	return slot->seq > index->num_dropped;
+}
+
+static void keyindex_append(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_keyindex_t *index = priv;
+	objectlog_keyindex_slot_t *slot = NULL;
+	uint64_t seq = index->num_appended++;
+	size_t mask = index->num_slots - 1;
+	size_t pos;
+	size_t i;
+	uint64_t key;
+
+	if (index->extract(log, entry, index->priv, &key)) {
+		return;
+	}
+
+	pos = keyindex_hash(key) & mask;
+	for (i = 0; i < index->num_slots; i++) {
+		objectlog_keyindex_slot_t *probe = &index->slots[(pos + i) & mask];
+
+		if (!probe->seq) {
+			if (!slot) {
+				slot = probe;
+			}
+			break;
+		}
+		if (probe->key == key) {
+			slot = probe;
+			break;
+		}
+		if (!slot && !keyindex_slot_is_live(index, probe)) {
+			slot = probe;
+		}
+	}
+
+	if (!slot) {
+		index->num_overflow++;
+		return;
+	}
+	slot->key = key;
+	slot->seq = seq + 1;
+	slot->entry = *entry;
+}
+
+static void keyindex_drop(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_keyindex_t *index = priv;
+
+	index->num_dropped++;
+}
+
+/**
+ * Attach key index to object log
+ * The index is stored in @arena, which must hold at least one slot. Objects
+ * already stored in the log are not indexed.
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_keyindex_init(objectlog_keyindex_t *index, objectlog_t *log,
+			    void *arena, size_t arena_size,
+			    objectlog_keyindex_extract_t extract, void *priv) {
+	uintptr_t align = _Alignof(objectlog_keyindex_slot_t);
+	uintptr_t arena_addr = (uintptr_t)arena;
+	uintptr_t slots_addr = (arena_addr + align - 1) & ~(align - 1);
+	size_t num_slots;
+
+	if (arena_size < slots_addr - arena_addr) {
+		return -1;
+	}
+	num_slots = (arena_size - (slots_addr - arena_addr)) / sizeof(objectlog_keyindex_slot_t);
+	if (!num_slots) {
+		return -1;
+	}
+	/* Round down to power of two for cheap masking */
+	while (num_slots & (num_slots - 1)) {
+		num_slots &= num_slots - 1;
+	}
+
+	index->log = log;
+	index->extract = extract;
+	index->priv = priv;
+	index->slots = (objectlog_keyindex_slot_t *)slots_addr;
+	index->num_slots = num_slots;
+	index->num_appended = log->num_entries;
+	index->num_dropped = 0;
+	index->num_overflow = 0;
+	memset(index->slots, 0, num_slots * sizeof(objectlog_keyindex_slot_t));
+
+	index->observer.append = keyindex_append;
+	index->observer.drop = keyindex_drop;
+	index->observer.priv = index;
+	objectlog_add_observer(log, &index->observer);
+	return 0;
+}
+
+void objectlog_keyindex_release(objectlog_keyindex_t *index) {
+	objectlog_remove_observer(index->log, &index->observer);
+}
+
+/**
+ * Obtain iterator for newest object with key @key
+ *
+ * @returns: 0 on success, -1 if no such object is stored
+ */
+int objectlog_keyindex_lookup(objectlog_keyindex_t *index, uint64_t key,
+			      objectlog_iterator_t *iterator) {
+	size_t mask = index->num_slots - 1;
+	size_t pos = keyindex_hash(key) & mask;
+	size_t i;
+
+	iterator->storage = NULL;
+	for (i = 0; i < index->num_slots; i++) {
+		objectlog_keyindex_slot_t *slot = &index->slots[(pos + i) & mask];
+
+		if (!slot->seq) {
+			break;
+		}
+		if (slot->key == key) {
+			if (!keyindex_slot_is_live(index, slot)) {
+				return -1;
+			}
+			*iterator = slot->entry;
+			return 0;
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "objectlog.h"
+
+typedef struct {
+	uint64_t key;
+	/* Sequence number of object plus one, zero for empty slots */
+	uint64_t seq;
+	objectlog_iterator_t entry;
+} objectlog_keyindex_slot_t;
+
+/*
+ * Extract key from object at @entry
+ * Returns 0 if the object has a key, non-zero if it does not.
+ */
+typedef int (*objectlog_keyindex_extract_t)(objectlog_t *log, const objectlog_iterator_t *entry,
+					    void *priv, uint64_t *key);
+
+typedef struct {
+	objectlog_t *log;
+	objectlog_observer_t observer;
+	objectlog_keyindex_extract_t extract;
+	void *priv;
+	objectlog_keyindex_slot_t *slots;
+	size_t num_slots;
+	/* Number of objects ever appended to and dropped from the log */
+	uint64_t num_appended;
+	uint64_t num_dropped;
+	unsigned long num_overflow;
+} objectlog_keyindex_t;
+
+int objectlog_keyindex_init(objectlog_keyindex_t *index, objectlog_t *log,
+			    void *arena, size_t arena_size,
+			    objectlog_keyindex_extract_t extract, void *priv);
+void objectlog_keyindex_release(objectlog_keyindex_t *index);
+int objectlog_keyindex_lookup(objectlog_keyindex_t *index, uint64_t key,
+			      objectlog_iterator_t *iterator);
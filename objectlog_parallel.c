@@ -0,0 +1,367 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "objectlog_parallel.h"
+#include "objectlog_priv.h"
+
+/*
+ * The live range of the log is split into independent sub-ranges starting
+ * at object boundaries. If the caller maintains checkpoints, ranges start
+ * at evenly spaced checkpoints. Otherwise, except on mirrored rings,
+ * fragments never cross region boundaries, thus the first object starting
+ * in a region is found by skipping fragments from the region start up to
+ * the end of the object in progress. On mirrored rings or if there are not
+ * enough regions objects are skipped from the start of the log instead,
+ * serially on the calling thread.
+ * Each thread works on a private copy of the log structure so iterating
+ * does not race on the shared read pointer. Worker threads are kept in a
+ * pool and woken for each call by bumping its generation.
+ */
+
+typedef struct {
+	objectlog_t log;
+	multiring_ptr_t start;
+	multiring_ptr_t end;
+	objectlog_parallel_fn_t fn;
+	void *acc;
+	void *priv;
+} parallel_range_t;
+
+static void *parallel_worker(void *arg) {
+	parallel_range_t *range = arg;
+	objectlog_iterator_t iter = range->start;
+
+	while (multiring_ptr_cmp(&iter, &range->end)) {
+		objectlog_iterator_t entry = iter;
+
+		range->fn(&range->log, &entry, range->acc, range->priv);
+		objectlog_next_entry(&range->log, &iter);
+	}
+
+	return NULL;
+}
+
+static objectlog_iterator_t *checkpoint(objectlog_checkpoints_t *checkpoints, unsigned int idx) {
+	return &checkpoints->points[(checkpoints->first + idx) % checkpoints->size];
+}
+
+static void checkpoints_append(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_checkpoints_t *checkpoints = priv;
+
+	if (checkpoints->num_skipped) {
+		checkpoints->num_skipped = (checkpoints->num_skipped + 1) % checkpoints->interval;
+		return;
+	}
+	checkpoints->num_skipped = 1 % checkpoints->interval;
+
+	/* Oldest checkpoint is lost if there is no space left */
+	if (checkpoints->num_points >= checkpoints->size) {
+		checkpoints->first = (checkpoints->first + 1) % checkpoints->size;
+		checkpoints->num_points--;
+	}
+	*checkpoint(checkpoints, checkpoints->num_points++) = *entry;
+}
+
+static void checkpoints_drop(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_checkpoints_t *checkpoints = priv;
+
+	if (checkpoints->num_points &&
+	    !multiring_ptr_cmp(checkpoint(checkpoints, 0), (multiring_ptr_t *)entry)) {
+		checkpoints->first = (checkpoints->first + 1) % checkpoints->size;
+		checkpoints->num_points--;
+	}
+}
+
+/**
+ * Record a checkpoint every @interval objects appended to @log
+ * Up to @size checkpoints are kept in @points, the oldest ones are lost if
+ * there is no space left. Objects already in the log are not covered. Size
+ * @points to hold the number of objects the log holds divided by @interval.
+ *
+ */
+void objectlog_checkpoints_init(objectlog_checkpoints_t *checkpoints, objectlog_t *log,
+				objectlog_iterator_t *points, unsigned int size,
+				unsigned int interval) {
+	checkpoints->log = log;
+	checkpoints->points = points;
+	checkpoints->size = size;
+	checkpoints->first = 0;
+	checkpoints->num_points = 0;
+	checkpoints->interval = interval ? interval : 1;
+	checkpoints->num_skipped = 0;
+	checkpoints->observer.append = size ? checkpoints_append : NULL;
+	checkpoints->observer.drop = checkpoints_drop;
+	checkpoints->observer.priv = checkpoints;
+	objectlog_add_observer(log, &checkpoints->observer);
+}
+
+void objectlog_checkpoints_release(objectlog_checkpoints_t *checkpoints) {
+	objectlog_remove_observer(checkpoints->log, &checkpoints->observer);
+}
+
+/*
+ * Split range from @points[0] to @points[@num_ranges] at checkpoints
+ *
+ * @returns: 0 on success, -1 if there are not enough checkpoints
+ */
+static int split_by_checkpoints(objectlog_checkpoints_t *checkpoints, multiring_ptr_t *points,
+				unsigned int num_ranges) {
+	unsigned int split;
+
+	if (checkpoints->num_points + 1 < num_ranges) {
+		return -1;
+	}
+	/* Objects before the first checkpoint form one more range */
+	for (split = 1; split < num_ranges; split++) {
+		points[split] = *checkpoint(checkpoints,
+					    split * checkpoints->num_points / num_ranges);
+	}
+	return 0;
+}
+
+/* Find first object starting at or after beginning of @region */
+static multiring_ptr_t region_first_entry(objectlog_t *log, const scatter_object_t *region) {
+	multiring_ptr_t ptr = { .storage = region, .offset = 0 };
+	uint8_t hdr;
+
+	do {
+		hdr = ((const uint8_t *)ptr.storage->ptr)[ptr.offset];
+		multiring_advance(&log->multiring, &ptr, 1 + FRAGMENT_LEN(hdr));
+	} while (!(hdr & FRAGMENT_FINAL));
+
+	return ptr;
+}
+
+/*
+ * Split range from @points[0] to @points[@num_ranges] at region boundaries
+ *
+ * @returns: 0 on success, -1 if there are not enough regions
+ */
+static int split_by_region(objectlog_t *log, multiring_ptr_t *points, unsigned int num_ranges) {
+	scatter_size_t total = multiring_byte_delta(&log->multiring, &points[0], &points[num_ranges]);
+	multiring_ptr_t region_ptr = points[0];
+	unsigned int split = 1;
+
+	/* Fragments wrap across the end of mirrored regions */
+	if (log->multiring.mirrored) {
+		return -1;
+	}
+
+	if (region_ptr.storage == points[num_ranges].storage &&
+	    region_ptr.offset <= points[num_ranges].offset) {
+		return -1;
+	}
+
+	do {
+		multiring_ptr_t candidate;
+		scatter_size_t offset;
+
+		multiring_next_ring(&log->multiring, &region_ptr);
+		if (region_ptr.storage == points[num_ranges].storage &&
+		    !points[num_ranges].offset) {
+			break;
+		}
+		candidate = region_first_entry(log, region_ptr.storage);
+		offset = multiring_byte_delta(&log->multiring, &points[0], &candidate);
+		if (offset >= total) {
+			break;
+		}
+		/* Use first candidate beyond the even share of the range */
+		if (offset >= split * (total / num_ranges)) {
+			points[split++] = candidate;
+		}
+	} while (split < num_ranges && region_ptr.storage != points[num_ranges].storage);
+
+	return split < num_ranges ? -1 : 0;
+}
+
+/* Split range from @points[0] to @points[@num_ranges] by number of objects */
+static void split_by_entries(objectlog_t *log, multiring_ptr_t *points, unsigned int num_ranges) {
+	multiring_ptr_t ptr = points[0];
+	unsigned int split;
+	unsigned int idx = 0;
+
+	for (split = 1; split < num_ranges; split++) {
+		unsigned int target = (unsigned long)log->num_entries * split / num_ranges;
+
+		while (idx < target) {
+			objectlog_next_entry(log, &ptr);
+			idx++;
+		}
+		points[split] = ptr;
+	}
+}
+
+static void *pool_worker(void *arg) {
+	objectlog_parallel_worker_t *worker = arg;
+	objectlog_parallel_pool_t *pool = worker->pool;
+	unsigned long generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1) {
+		parallel_range_t *ranges;
+
+		if (pool->stop) {
+			break;
+		}
+		if (pool->generation == generation) {
+			pthread_cond_wait(&pool->cond_start, &pool->lock);
+			continue;
+		}
+		generation = pool->generation;
+		ranges = pool->ranges;
+		pthread_mutex_unlock(&pool->lock);
+
+		parallel_worker(&ranges[worker->idx]);
+
+		pthread_mutex_lock(&pool->lock);
+		if (!--pool->num_busy) {
+			pthread_cond_signal(&pool->cond_done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+static void pool_stop(objectlog_parallel_pool_t *pool, unsigned int num_started) {
+	unsigned int idx;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->cond_start);
+	pthread_mutex_unlock(&pool->lock);
+	for (idx = 0; idx < num_started; idx++) {
+		pthread_join(pool->workers[idx].thread, NULL);
+	}
+	pthread_cond_destroy(&pool->cond_done);
+	pthread_cond_destroy(&pool->cond_start);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/**
+ * Start pool of @num_threads threads for objectlog_parallel_for_each
+ * The calling thread counts towards @num_threads, thus @num_threads - 1
+ * worker threads are started.
+ *
+ * @returns: 0 on success, negative error code on failure
+ */
+int objectlog_parallel_pool_init(objectlog_parallel_pool_t *pool, unsigned int num_threads) {
+	unsigned int idx;
+	int err;
+
+	if (!num_threads || num_threads > OBJECTLOG_PARALLEL_MAX_THREADS) {
+		return -EINVAL;
+	}
+
+	pool->num_threads = num_threads;
+	pool->ranges = NULL;
+	pool->generation = 0;
+	pool->num_busy = 0;
+	pool->stop = false;
+	err = -pthread_mutex_init(&pool->lock, NULL);
+	if (err) {
+		return err;
+	}
+	err = -pthread_cond_init(&pool->cond_start, NULL);
+	if (err) {
+		goto fail_lock;
+	}
+	err = -pthread_cond_init(&pool->cond_done, NULL);
+	if (err) {
+		goto fail_cond_start;
+	}
+
+	for (idx = 0; idx < num_threads - 1; idx++) {
+		objectlog_parallel_worker_t *worker = &pool->workers[idx];
+
+		worker->pool = pool;
+		worker->idx = idx;
+		err = -pthread_create(&worker->thread, NULL, pool_worker, worker);
+		if (err) {
+			pool_stop(pool, idx);
+			return err;
+		}
+	}
+	return 0;
+
+fail_cond_start:
+	pthread_cond_destroy(&pool->cond_start);
+fail_lock:
+	pthread_mutex_destroy(&pool->lock);
+	return err;
+}
+
+void objectlog_parallel_pool_release(objectlog_parallel_pool_t *pool) {
+	pool_stop(pool, pool->num_threads - 1);
+}
+
+/**
+ * Call @fn for each object on all threads of @pool in parallel
+ * Each thread accumulates into its own element of @accs, an array of
+ * one initialized accumulator of @acc_size bytes per pool thread. Finally
+ * all accumulators are merged into the first one using @reduce. With
+ * @checkpoints of @log given, the log is split at checkpoints, else at
+ * region boundaries if possible. The log must not be modified while this
+ * method runs, calls on the same pool must not overlap.
+ *
+ * @returns: 0 on success, negative error code on failure
+ */
+int objectlog_parallel_for_each(objectlog_parallel_pool_t *pool, objectlog_t *log,
+				objectlog_checkpoints_t *checkpoints,
+				objectlog_parallel_fn_t fn, objectlog_parallel_reduce_t reduce,
+				void *accs, size_t acc_size, void *priv) {
+	parallel_range_t ranges[OBJECTLOG_PARALLEL_MAX_THREADS];
+	multiring_ptr_t points[OBJECTLOG_PARALLEL_MAX_THREADS + 1];
+	unsigned int num_threads = pool->num_threads;
+	unsigned int idx;
+
+	if (checkpoints && checkpoints->log != log) {
+		return -EINVAL;
+	}
+	if (!log->num_entries) {
+		return 0;
+	}
+
+	points[0] = log->ptr_first;
+	points[num_threads] = log->ptr_last;
+	objectlog_next_entry(log, &points[num_threads]);
+	if (num_threads > 1 &&
+	    (!checkpoints || split_by_checkpoints(checkpoints, points, num_threads)) &&
+	    split_by_region(log, points, num_threads)) {
+		split_by_entries(log, points, num_threads);
+	}
+
+	for (idx = 0; idx < num_threads; idx++) {
+		parallel_range_t *range = &ranges[idx];
+
+		range->log = *log;
+		range->start = points[idx];
+		range->end = points[idx + 1];
+		range->fn = fn;
+		range->acc = (uint8_t *)accs + idx * acc_size;
+		range->priv = priv;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->ranges = ranges;
+	pool->num_busy = num_threads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->cond_start);
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Run last range on calling thread */
+	parallel_worker(&ranges[num_threads - 1]);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->num_busy) {
+		pthread_cond_wait(&pool->cond_done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	for (idx = 1; idx < num_threads; idx++) {
+		reduce(accs, (uint8_t *)accs + idx * acc_size, priv);
+	}
+	return 0;
+}
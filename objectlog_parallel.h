@@ -0,0 +1,65 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "objectlog.h"
+
+#define OBJECTLOG_PARALLEL_MAX_THREADS 64
+
+/*
+ * Called for each object. @log is a private view of the log for use with
+ * the iterator API from the calling thread, @acc the accumulator of the
+ * calling thread.
+ */
+typedef void (*objectlog_parallel_fn_t)(objectlog_t *log, const objectlog_iterator_t *entry,
+					void *acc, void *priv);
+/* Merge accumulator @other into @acc */
+typedef void (*objectlog_parallel_reduce_t)(void *acc, const void *other, void *priv);
+
+/* Iterators of every @interval-th object appended, kept in a caller-owned ring */
+typedef struct {
+	objectlog_t *log;
+	objectlog_observer_t observer;
+	objectlog_iterator_t *points;
+	unsigned int size;
+	unsigned int first;
+	unsigned int num_points;
+	unsigned int interval;
+	/* Objects appended since the newest checkpoint */
+	unsigned int num_skipped;
+} objectlog_checkpoints_t;
+
+struct objectlog_parallel_pool;
+
+typedef struct {
+	struct objectlog_parallel_pool *pool;
+	unsigned int idx;
+	pthread_t thread;
+} objectlog_parallel_worker_t;
+
+/* Worker threads reused across calls, the calling thread works as well */
+typedef struct objectlog_parallel_pool {
+	unsigned int num_threads;
+	objectlog_parallel_worker_t workers[OBJECTLOG_PARALLEL_MAX_THREADS - 1];
+	/* Ranges of the current call, one per thread */
+	void *ranges;
+	unsigned long generation;
+	unsigned int num_busy;
+	bool stop;
+	pthread_mutex_t lock;
+	pthread_cond_t cond_start;
+	pthread_cond_t cond_done;
+} objectlog_parallel_pool_t;
+
+void objectlog_checkpoints_init(objectlog_checkpoints_t *checkpoints, objectlog_t *log,
+				objectlog_iterator_t *points, unsigned int size,
+				unsigned int interval);
+void objectlog_checkpoints_release(objectlog_checkpoints_t *checkpoints);
+int objectlog_parallel_pool_init(objectlog_parallel_pool_t *pool, unsigned int num_threads);
+void objectlog_parallel_pool_release(objectlog_parallel_pool_t *pool);
+int objectlog_parallel_for_each(objectlog_parallel_pool_t *pool, objectlog_t *log,
+				objectlog_checkpoints_t *checkpoints,
+				objectlog_parallel_fn_t fn, objectlog_parallel_reduce_t reduce,
+				void *accs, size_t acc_size, void *priv);
@@ -0,0 +1,380 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include "objectlog_persist.h"
+#include "objectlog_priv.h"
+
+/*
+ * The log is mirrored to @fd by two threads. The stager copies unflushed
+ * objects to one of two staging buffers while the writer writes the other
+ * one to @fd. The log lock is only held to snapshot the flushed cursor, the
+ * copy itself runs unlocked, so producers never wait for a memcpy or I/O.
+ * Producers may overwrite objects while they are being copied. Objects are
+ * always dropped before their storage is reused and drops of unflushed
+ * objects are accounted in bytes_dropped. Once the copy is done, all bytes
+ * dropped meanwhile are skipped from the start of the staging buffer, the
+ * objects are counted as lost, similar to a seqlock retry.
+ * Objects are written as stored in the log, a sequence of fragment headers
+ * followed by fragment data.
+ */
+
+static void persist_append(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_persist_t *persist = priv;
+
+	if (!persist->num_unflushed) {
+		persist->ptr_flushed = *entry;
+	}
+	persist->num_unflushed++;
+}
+
+static void persist_drop(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_persist_t *persist = priv;
+	multiring_ptr_t next = *entry;
+
+	/* Object is overwritten before it could be handed to the writer */
+	if (persist->num_unflushed &&
+	    !multiring_ptr_cmp(&persist->ptr_flushed, (multiring_ptr_t *)entry)) {
+		objectlog_next_entry(log, &next);
+		persist->bytes_dropped += multiring_byte_delta(&log->multiring, &persist->ptr_flushed,
+							       &next);
+		persist->ptr_flushed = next;
+		persist->num_unflushed--;
+		persist->num_lost++;
+	}
+}
+
+/* Copy ring layout of @log to @view, the read pointer is owned by readers */
+static void persist_view(objectlog_t *view, const objectlog_t *log) {
+	view->multiring.storage = log->multiring.storage;
+	view->multiring.num_storage = log->multiring.num_storage;
+	view->multiring.max_storage = log->multiring.max_storage;
+	view->multiring.next_ring = log->multiring.next_ring;
+	view->multiring.mirrored = log->multiring.mirrored;
+	view->multiring.ptr_write = log->multiring.ptr_write;
+	view->multiring.size = log->multiring.size;
+}
+
+/* Length of staged object at @data, 0 if it is not complete within @len bytes */
+static scatter_size_t persist_entry_len(const uint8_t *data, scatter_size_t len) {
+	scatter_size_t pos = 0;
+	uint8_t hdr;
+
+	do {
+		if (pos >= len) {
+			return 0;
+		}
+		hdr = data[pos];
+		pos += 1 + FRAGMENT_LEN(hdr);
+	} while (!(hdr & FRAGMENT_FINAL));
+
+	return pos <= len ? pos : 0;
+}
+
+/* Stage unflushed objects to @buf, call locked, the lock is dropped for copying */
+static void persist_stage(objectlog_persist_t *persist, objectlog_persist_buf_t *buf) {
+	multiring_ptr_t start = persist->ptr_flushed;
+	unsigned long bytes_dropped = persist->bytes_dropped;
+	unsigned int num_objects = 0;
+	scatter_size_t copy_len;
+	scatter_size_t offset;
+	scatter_size_t len = 0;
+	objectlog_t view;
+
+	persist_view(&view, persist->log);
+	/* Unflushed objects are contiguous up to the end of the log */
+	copy_len = multiring_byte_delta(&view.multiring, &start, &view.multiring.ptr_write);
+	if (copy_len > persist->buf_size) {
+		copy_len = persist->buf_size;
+	}
+
+	persist->staging = true;
+	pthread_mutex_unlock(&persist->lock);
+	view.multiring.ptr_read = start;
+	multiring_read(&view.multiring, buf->data, copy_len);
+	pthread_mutex_lock(&persist->lock);
+	persist->staging = false;
+
+	/* Skip objects dropped during the copy, they might be torn */
+	offset = persist->bytes_dropped - bytes_dropped;
+	if (!persist->num_unflushed || offset >= copy_len) {
+		return;
+	}
+	while (num_objects < persist->num_unflushed) {
+		scatter_size_t entry_len = persist_entry_len(buf->data + offset + len,
+							     copy_len - offset - len);
+
+		if (!entry_len) {
+			break;
+		}
+		len += entry_len;
+		num_objects++;
+	}
+
+	persist_view(&view, persist->log);
+	if (!num_objects) {
+		/* Object can never be staged, skip it */
+		objectlog_next_entry(&view, &persist->ptr_flushed);
+		persist->num_unflushed--;
+		persist->num_lost++;
+		return;
+	}
+
+	multiring_advance(&view.multiring, &persist->ptr_flushed, len);
+	persist->num_unflushed -= num_objects;
+	persist->num_flushed += num_objects;
+	buf->offset = offset;
+	buf->len = len;
+}
+
+static int persist_write(objectlog_persist_t *persist, const objectlog_persist_buf_t *buf) {
+	const uint8_t *data8 = buf->data + buf->offset;
+	scatter_size_t len = buf->len;
+
+	while (len) {
+		ssize_t written = pwrite(persist->fd, data8, len, persist->file_offset);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -errno;
+		}
+		data8 += written;
+		len -= written;
+		persist->file_offset += written;
+	}
+
+	return 0;
+}
+
+static bool persist_idle(objectlog_persist_t *persist) {
+	return !persist->num_unflushed && !persist->staging &&
+	       !persist->bufs[0].len && !persist->bufs[1].len;
+}
+
+static void *persist_worker(void *arg) {
+	objectlog_persist_t *persist = arg;
+	unsigned int fill = 0;
+
+	pthread_mutex_lock(&persist->lock);
+	while (!persist->err) {
+		objectlog_persist_buf_t *buf = &persist->bufs[fill];
+
+		/* Wait for objects and for the writer to free the next buffer */
+		if (!persist->num_unflushed || buf->len) {
+			if (persist_idle(persist)) {
+				pthread_cond_broadcast(&persist->cond_idle);
+				if (persist->stop) {
+					break;
+				}
+			}
+			pthread_cond_wait(&persist->cond_work, &persist->lock);
+			continue;
+		}
+
+		persist_stage(persist, buf);
+		if (buf->len) {
+			pthread_cond_signal(&persist->cond_write);
+			fill = !fill;
+		}
+	}
+	persist->done = true;
+	pthread_cond_signal(&persist->cond_write);
+	pthread_cond_broadcast(&persist->cond_idle);
+	pthread_mutex_unlock(&persist->lock);
+
+	return NULL;
+}
+
+static void *persist_writer(void *arg) {
+	objectlog_persist_t *persist = arg;
+	unsigned int drain = 0;
+
+	pthread_mutex_lock(&persist->lock);
+	while (1) {
+		objectlog_persist_buf_t *buf = &persist->bufs[drain];
+		int err = 0;
+
+		if (!buf->len) {
+			if (persist->done) {
+				break;
+			}
+			pthread_cond_wait(&persist->cond_write, &persist->lock);
+			continue;
+		}
+
+		/* Buffers are only handed back once written, no lock needed */
+		if (!persist->err) {
+			pthread_mutex_unlock(&persist->lock);
+			err = persist_write(persist, buf);
+			pthread_mutex_lock(&persist->lock);
+		}
+		if (err) {
+			persist->err = err;
+		}
+		buf->len = 0;
+		drain = !drain;
+		pthread_cond_signal(&persist->cond_work);
+		pthread_cond_broadcast(&persist->cond_idle);
+	}
+	pthread_mutex_unlock(&persist->lock);
+
+	return NULL;
+}
+
+/**
+ * Start mirroring objects written to @log to file descriptor @fd
+ * Objects must be written through objectlog_persist_write_* from now on.
+ * @buf is split into two staging buffers, each half should be able to hold
+ * the largest object including its fragment headers, objects that do not
+ * fit are lost. Regions must not be added to or removed from @log while
+ * persisting.
+ *
+ * @returns: 0 on success, negative error code on failure
+ */
+int objectlog_persist_init(objectlog_persist_t *persist, objectlog_t *log, int fd,
+			   void *buf, scatter_size_t buf_size) {
+	int err;
+
+	persist->log = log;
+	persist->fd = fd;
+	persist->file_offset = 0;
+	persist->buf_size = buf_size / 2;
+	persist->bufs[0].data = buf;
+	persist->bufs[0].len = 0;
+	persist->bufs[1].data = (uint8_t *)buf + persist->buf_size;
+	persist->bufs[1].len = 0;
+	persist->num_unflushed = 0;
+	persist->bytes_dropped = 0;
+	persist->num_flushed = 0;
+	persist->num_lost = 0;
+	persist->staging = false;
+	persist->stop = false;
+	persist->done = false;
+	persist->err = 0;
+
+	err = -pthread_mutex_init(&persist->lock, NULL);
+	if (err) {
+		return err;
+	}
+	err = -pthread_cond_init(&persist->cond_work, NULL);
+	if (err) {
+		goto fail_lock;
+	}
+	err = -pthread_cond_init(&persist->cond_write, NULL);
+	if (err) {
+		goto fail_cond_work;
+	}
+	err = -pthread_cond_init(&persist->cond_idle, NULL);
+	if (err) {
+		goto fail_cond_write;
+	}
+
+	persist->observer.append = persist_append;
+	persist->observer.drop = persist_drop;
+	persist->observer.priv = persist;
+	objectlog_add_observer(log, &persist->observer);
+
+	err = -pthread_create(&persist->writer, NULL, persist_writer, persist);
+	if (err) {
+		goto fail_observer;
+	}
+	err = -pthread_create(&persist->thread, NULL, persist_worker, persist);
+	if (err) {
+		goto fail_writer;
+	}
+	return 0;
+
+fail_writer:
+	pthread_mutex_lock(&persist->lock);
+	persist->done = true;
+	pthread_cond_signal(&persist->cond_write);
+	pthread_mutex_unlock(&persist->lock);
+	pthread_join(persist->writer, NULL);
+fail_observer:
+	objectlog_remove_observer(log, &persist->observer);
+	pthread_cond_destroy(&persist->cond_idle);
+fail_cond_write:
+	pthread_cond_destroy(&persist->cond_write);
+fail_cond_work:
+	pthread_cond_destroy(&persist->cond_work);
+fail_lock:
+	pthread_mutex_destroy(&persist->lock);
+	return err;
+}
+
+/**
+ * Flush all pending objects and stop worker threads
+ *
+ */
+void objectlog_persist_release(objectlog_persist_t *persist) {
+	pthread_mutex_lock(&persist->lock);
+	persist->stop = true;
+	pthread_cond_signal(&persist->cond_work);
+	pthread_mutex_unlock(&persist->lock);
+	pthread_join(persist->thread, NULL);
+	pthread_join(persist->writer, NULL);
+
+	objectlog_remove_observer(persist->log, &persist->observer);
+	pthread_cond_destroy(&persist->cond_idle);
+	pthread_cond_destroy(&persist->cond_write);
+	pthread_cond_destroy(&persist->cond_work);
+	pthread_mutex_destroy(&persist->lock);
+}
+
+/**
+ * Wait until all objects written so far are either persisted or lost
+ *
+ * @returns: 0 on success, negative error code of failed write on failure
+ */
+int objectlog_persist_flush(objectlog_persist_t *persist) {
+	int err;
+
+	pthread_mutex_lock(&persist->lock);
+	while (!persist->err && !persist_idle(persist)) {
+		pthread_cond_wait(&persist->cond_idle, &persist->lock);
+	}
+	err = persist->err;
+	pthread_mutex_unlock(&persist->lock);
+
+	return err;
+}
+
+scatter_size_t objectlog_persist_write_scattered_object(objectlog_persist_t *persist,
+							const scatter_object_t *scatter_list) {
+	scatter_size_t ret;
+
+	pthread_mutex_lock(&persist->lock);
+	ret = objectlog_write_scattered_object(persist->log, scatter_list);
+	if (!ret) {
+		pthread_cond_signal(&persist->cond_work);
+	}
+	pthread_mutex_unlock(&persist->lock);
+
+	return ret;
+}
+
+scatter_size_t objectlog_persist_write_object(objectlog_persist_t *persist,
+					      const void *data, scatter_size_t len) {
+	scatter_object_t scatter_list[] = {
+		/* Cast to non-const for compatibility, still never written */
+		{ .ptr = (void *)data, .len = len },
+		{ .len = 0 }
+	};
+
+	return objectlog_persist_write_scattered_object(persist, scatter_list);
+}
+
+/**
+ * Get number of objects overwritten before they could be persisted
+ *
+ */
+unsigned long objectlog_persist_num_lost(objectlog_persist_t *persist) {
+	unsigned long num_lost;
+
+	pthread_mutex_lock(&persist->lock);
+	num_lost = persist->num_lost;
+	pthread_mutex_unlock(&persist->lock);
+
+	return num_lost;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "objectlog.h"
+#include "scatter.h"
+
+typedef struct {
+	uint8_t *data;
+	/* Staged bytes start at @offset, buffer is free if @len is 0 */
+	scatter_size_t offset;
+	scatter_size_t len;
+} objectlog_persist_buf_t;
+
+typedef struct {
+	objectlog_t *log;
+	objectlog_observer_t observer;
+	int fd;
+	off_t file_offset;
+	/* One buffer is filled while the other one is written */
+	objectlog_persist_buf_t bufs[2];
+	scatter_size_t buf_size;
+	/* First object not yet handed to the writer, valid if num_unflushed > 0 */
+	multiring_ptr_t ptr_flushed;
+	unsigned int num_unflushed;
+	/* Bytes of unflushed objects dropped so far, detects overwrites while staging */
+	unsigned long bytes_dropped;
+	unsigned long num_flushed;
+	unsigned long num_lost;
+	bool staging;
+	bool stop;
+	bool done;
+	int err;
+	pthread_mutex_t lock;
+	pthread_cond_t cond_work;
+	pthread_cond_t cond_write;
+	pthread_cond_t cond_idle;
+	pthread_t thread;
+	pthread_t writer;
+} objectlog_persist_t;
+
+int objectlog_persist_init(objectlog_persist_t *persist, objectlog_t *log, int fd,
+			   void *buf, scatter_size_t buf_size);
+void objectlog_persist_release(objectlog_persist_t *persist);
+int objectlog_persist_flush(objectlog_persist_t *persist);
+scatter_size_t objectlog_persist_write_scattered_object(objectlog_persist_t *persist,
+							const scatter_object_t *scatter_list);
+scatter_size_t objectlog_persist_write_object(objectlog_persist_t *persist,
+					      const void *data, scatter_size_t len);
+unsigned long objectlog_persist_num_lost(objectlog_persist_t *persist);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "objectlog.h"
+
+/* Internal interface shared by object log core and its write paths */
+
+#define MAX_FRAGMENT_LEN 0x7f
+#define FRAGMENT_FINAL 0x80
+#define FRAGMENT_LEN(x) ((x) & MAX_FRAGMENT_LEN)
+
+#define DIV_ROUND_UP(x, y) (((x) + ((y) - 1)) / (y))
+
+scatter_size_t objectlog_make_room(objectlog_t *log, scatter_size_t len);
+void objectlog_commit_object(objectlog_t *log, const multiring_ptr_t *new_last);
+void objectlog_abort_object(objectlog_t *log, const multiring_ptr_t *start);
@@ -0,0 +1,163 @@
+#include "objectlog_rollup.h"
+
+/*
+ * Buckets are kept in a ring in log order. A new bucket is started whenever
+ * the extracted window differs from the one of the newest bucket. Buckets
+ * are retired once all objects appended while they were the newest have
+ * been evicted from the log. Until then the aggregate of the oldest bucket
+ * still includes values of already evicted objects.
+ */
+
+static objectlog_rollup_bucket_t *rollup_bucket(objectlog_rollup_t *rollup, unsigned int idx) {
+	return &rollup->buckets[(rollup->first + idx) % rollup->size];
+}
+
+static void rollup_retire_first(objectlog_rollup_t *rollup) {
+	rollup->num_untracked += rollup_bucket(rollup, 0)->num_entries;
+	rollup->first = (rollup->first + 1) % rollup->size;
+	rollup->num_buckets--;
+}
+
+static void rollup_append(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_rollup_t *rollup = priv;
+	objectlog_rollup_bucket_t *bucket = NULL;
+	uint64_t window;
+	int64_t value;
+
+	if (!rollup->size) {
+		rollup->num_untracked++;
+		return;
+	}
+	if (rollup->num_buckets) {
+		bucket = rollup_bucket(rollup, rollup->num_buckets - 1);
+	}
+
+	if (rollup->extract(log, entry, rollup->priv, &window, &value)) {
+		if (bucket) {
+			bucket->num_entries++;
+		} else {
+			rollup->num_untracked++;
+		}
+		return;
+	}
+
+	if (!bucket || bucket->window != window) {
+		/* Oldest window is lost if there is no space left */
+		if (rollup->num_buckets >= rollup->size) {
+			rollup_retire_first(rollup);
+		}
+		bucket = rollup_bucket(rollup, rollup->num_buckets++);
+		bucket->window = window;
+		bucket->min = value;
+		bucket->max = value;
+		bucket->sum = 0;
+		bucket->count = 0;
+		bucket->num_entries = 0;
+	}
+
+	if (value < bucket->min) {
+		bucket->min = value;
+	}
+	if (value > bucket->max) {
+		bucket->max = value;
+	}
+	bucket->sum += value;
+	bucket->count++;
+	bucket->num_entries++;
+}
+
+static void rollup_drop(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_rollup_t *rollup = priv;
+	objectlog_rollup_bucket_t *bucket;
+
+	if (rollup->num_untracked) {
+		rollup->num_untracked--;
+		return;
+	}
+	if (!rollup->num_buckets) {
+		return;
+	}
+
+	bucket = rollup_bucket(rollup, 0);
+	if (!--bucket->num_entries) {
+		rollup_retire_first(rollup);
+	}
+}
+
+/**
+ * Attach rollup aggregation to object log
+ * Objects already stored in the log are not aggregated. @buckets must be
+ * able to hold @size windows.
+ *
+ */
+void objectlog_rollup_init(objectlog_rollup_t *rollup, objectlog_t *log,
+			   objectlog_rollup_bucket_t *buckets, unsigned int size,
+			   objectlog_rollup_extract_t extract, void *priv) {
+	rollup->log = log;
+	rollup->extract = extract;
+	rollup->priv = priv;
+	rollup->buckets = buckets;
+	rollup->size = size;
+	rollup->first = 0;
+	rollup->num_buckets = 0;
+	rollup->num_untracked = log->num_entries;
+	rollup->observer.append = rollup_append;
+	rollup->observer.drop = rollup_drop;
+	rollup->observer.priv = rollup;
+	objectlog_add_observer(log, &rollup->observer);
+}
+
+void objectlog_rollup_release(objectlog_rollup_t *rollup) {
+	objectlog_remove_observer(rollup->log, &rollup->observer);
+}
+
+/**
+ * Get bucket at index @idx
+ * Negative indices count from newest to oldest bucket.
+ *
+ * @returns: non-NULL pointer to bucket on success, NULL on failure
+ */
+const objectlog_rollup_bucket_t *objectlog_rollup_bucket(objectlog_rollup_t *rollup, int idx) {
+	if (idx < 0) {
+		idx += (int)rollup->num_buckets;
+	}
+	if (idx < 0 || idx >= (int)rollup->num_buckets) {
+		return NULL;
+	}
+
+	return rollup_bucket(rollup, idx);
+}
+
+/**
+ * Combine all buckets with windows from @window_first to @window_last
+ *
+ * @returns: 0 on success, -1 if there are no values in range
+ */
+int objectlog_rollup_summary(objectlog_rollup_t *rollup, uint64_t window_first,
+			     uint64_t window_last, objectlog_rollup_bucket_t *summary) {
+	unsigned int idx;
+
+	summary->window = window_first;
+	summary->sum = 0;
+	summary->count = 0;
+	summary->num_entries = 0;
+	for (idx = 0; idx < rollup->num_buckets; idx++) {
+		const objectlog_rollup_bucket_t *bucket = rollup_bucket(rollup, idx);
+
+		if (bucket->window < window_first || bucket->window > window_last) {
+			continue;
+		}
+
+		if (!summary->count || bucket->min < summary->min) {
+			summary->min = bucket->min;
+		}
+		if (!summary->count || bucket->max > summary->max) {
+			summary->max = bucket->max;
+		}
+		summary->sum += bucket->sum;
+		summary->count += bucket->count;
+		summary->num_entries += bucket->num_entries;
+	}
+
+	return summary->count ? 0 : -1;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "objectlog.h"
+
+typedef struct {
+	uint64_t window;
+	int64_t min;
+	int64_t max;
+	int64_t sum;
+	unsigned int count;
+	/* Number of log objects appended while this window was the newest */
+	unsigned int num_entries;
+} objectlog_rollup_bucket_t;
+
+/*
+ * Extract window and value from object at @entry
+ * Returns 0 if the object contributes a value, non-zero if it does not.
+ */
+typedef int (*objectlog_rollup_extract_t)(objectlog_t *log, const objectlog_iterator_t *entry,
+					  void *priv, uint64_t *window, int64_t *value);
+
+typedef struct {
+	objectlog_t *log;
+	objectlog_observer_t observer;
+	objectlog_rollup_extract_t extract;
+	void *priv;
+	objectlog_rollup_bucket_t *buckets;
+	unsigned int size;
+	unsigned int first;
+	unsigned int num_buckets;
+	/* Objects in the log not accounted for in any bucket */
+	unsigned int num_untracked;
+} objectlog_rollup_t;
+
+void objectlog_rollup_init(objectlog_rollup_t *rollup, objectlog_t *log,
+			   objectlog_rollup_bucket_t *buckets, unsigned int size,
+			   objectlog_rollup_extract_t extract, void *priv);
+void objectlog_rollup_release(objectlog_rollup_t *rollup);
+const objectlog_rollup_bucket_t *objectlog_rollup_bucket(objectlog_rollup_t *rollup, int idx);
+int objectlog_rollup_summary(objectlog_rollup_t *rollup, uint64_t window_first,
+			     uint64_t window_last, objectlog_rollup_bucket_t *summary);
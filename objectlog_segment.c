@@ -0,0 +1,236 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "objectlog_segment.h"
+
+/*
+ * Objects are grouped into segments of consecutive objects spanning about
+ * @segment_size bytes of the log each. Every segment keeps the bounds of
+ * the keys and a bloom filter over the tokens of its objects. Segments are
+ * discarded once all of their objects have been evicted. Scans skip all
+ * segments that can not contain a match without touching their objects.
+ */
+
+#define BLOOM_NUM_HASHES 3
+
+static objectlog_segment_t *segment_at(objectlog_segments_t *segs, unsigned int idx) {
+	return &segs->segments[(segs->first + idx) % segs->size];
+}
+
+static void segments_retire_first(objectlog_segments_t *segs) {
+	segs->num_untracked += segment_at(segs, 0)->num_entries;
+	segs->first = (segs->first + 1) % segs->size;
+	segs->num_segments--;
+}
+
+static unsigned int bloom_bit(uint64_t hash, unsigned int i) {
+	/* Double hashing, derive all bit positions from halves of @hash */
+	uint32_t h1 = hash;
+	uint32_t h2 = hash >> 32;
+
+	return (h1 + i * h2) % OBJECTLOG_SEGMENT_BLOOM_BITS;
+}
+
+static void bloom_add(objectlog_segment_t *segment, uint64_t hash) {
+	unsigned int i;
+
+	for (i = 0; i < BLOOM_NUM_HASHES; i++) {
+		unsigned int bit = bloom_bit(hash, i);
+
+		segment->bloom[bit / 8] |= 1 << (bit % 8);
+	}
+}
+
+static bool bloom_test(const objectlog_segment_t *segment, uint64_t hash) {
+	unsigned int i;
+
+	for (i = 0; i < BLOOM_NUM_HASHES; i++) {
+		unsigned int bit = bloom_bit(hash, i);
+
+		if (!(segment->bloom[bit / 8] & (1 << (bit % 8)))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static objectlog_segment_t *segments_open(objectlog_segments_t *segs,
+					  const objectlog_iterator_t *entry) {
+	objectlog_segment_t *segment;
+
+	if (segs->num_segments) {
+		segment = segment_at(segs, segs->num_segments - 1);
+		if (multiring_byte_delta(&segs->log->multiring, &segment->first,
+					 &segs->log->multiring.ptr_write) <= segs->segment_size) {
+			return segment;
+		}
+	}
+
+	/* Oldest segment is lost if there is no space left */
+	if (segs->num_segments >= segs->size) {
+		segments_retire_first(segs);
+	}
+	segment = segment_at(segs, segs->num_segments++);
+	segment->first = *entry;
+	segment->num_entries = 0;
+	segment->num_keys = 0;
+	memset(segment->bloom, 0, sizeof(segment->bloom));
+	return segment;
+}
+
+static void segments_append(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_segments_t *segs = priv;
+	objectlog_segment_t *segment;
+	uint64_t tokens[OBJECTLOG_SEGMENT_MAX_TOKENS];
+	unsigned int num_tokens = 0;
+	unsigned int i;
+	uint64_t key;
+
+	if (!segs->size) {
+		segs->num_untracked++;
+		return;
+	}
+
+	segment = segments_open(segs, entry);
+	segment->num_entries++;
+	if (segs->extract(log, entry, segs->priv, &key, tokens, &num_tokens)) {
+		return;
+	}
+
+	if (!segment->num_keys || key < segment->key_min) {
+		segment->key_min = key;
+	}
+	if (!segment->num_keys || key > segment->key_max) {
+		segment->key_max = key;
+	}
+	segment->num_keys++;
+	for (i = 0; i < num_tokens && i < OBJECTLOG_SEGMENT_MAX_TOKENS; i++) {
+		bloom_add(segment, tokens[i]);
+	}
+}
+
+static void segments_drop(objectlog_t *log, const objectlog_iterator_t *entry, void *priv) {
+	objectlog_segments_t *segs = priv;
+
+	if (segs->num_untracked) {
+		segs->num_untracked--;
+		return;
+	}
+	if (!segs->num_segments) {
+		return;
+	}
+
+	if (!--segment_at(segs, 0)->num_entries) {
+		segments_retire_first(segs);
+	}
+}
+
+/**
+ * Attach segment summaries to object log
+ * A new segment is started once the current one spans more than
+ * @segment_size bytes. Objects already stored in the log are not covered
+ * by any segment and are always scanned.
+ *
+ */
+void objectlog_segments_init(objectlog_segments_t *segs, objectlog_t *log,
+			     objectlog_segment_t *segments, unsigned int size,
+			     scatter_size_t segment_size,
+			     objectlog_segment_extract_t extract, void *priv) {
+	segs->log = log;
+	segs->extract = extract;
+	segs->priv = priv;
+	segs->segments = segments;
+	segs->size = size;
+	segs->first = 0;
+	segs->num_segments = 0;
+	segs->segment_size = segment_size;
+	segs->num_untracked = log->num_entries;
+	segs->observer.append = segments_append;
+	segs->observer.drop = segments_drop;
+	segs->observer.priv = segs;
+	objectlog_add_observer(log, &segs->observer);
+}
+
+void objectlog_segments_release(objectlog_segments_t *segs) {
+	objectlog_remove_observer(segs->log, &segs->observer);
+}
+
+/**
+ * Hash token for use with segment bloom filters (FNV-1a)
+ *
+ */
+uint64_t objectlog_segment_hash(const void *data, size_t len) {
+	const uint8_t *data8 = data;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (len--) {
+		hash ^= *data8++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static int scan_entries(objectlog_segments_t *segs, objectlog_iterator_t iter,
+			unsigned int num_entries, objectlog_segment_visit_t visit, void *priv) {
+	while (num_entries--) {
+		objectlog_iterator_t entry = iter;
+		int ret;
+
+		ret = visit(segs->log, &entry, priv);
+		if (ret) {
+			return ret;
+		}
+		objectlog_next_entry(segs->log, &iter);
+	}
+
+	return 0;
+}
+
+/**
+ * Visit objects possibly matching key range @key_min to @key_max and,
+ * unless NULL, token hash @token
+ * Segments that can not contain a match are skipped. @visit still has to
+ * check each object it is called for.
+ *
+ * @returns: 0 after all candidates were visited, else return value of @visit
+ */
+int objectlog_segment_scan(objectlog_segments_t *segs, uint64_t key_min, uint64_t key_max,
+			   const uint64_t *token, objectlog_segment_visit_t visit, void *priv) {
+	objectlog_t *log = segs->log;
+	objectlog_iterator_t iter = log->ptr_first;
+	unsigned int idx;
+	int ret;
+
+	if (!log->num_entries) {
+		return 0;
+	}
+
+	ret = scan_entries(segs, iter, segs->num_untracked, visit, priv);
+	if (ret) {
+		return ret;
+	}
+
+	for (idx = 0; idx < segs->num_segments; idx++) {
+		objectlog_segment_t *segment = segment_at(segs, idx);
+
+		if (!segment->num_keys || segment->key_max < key_min || segment->key_min > key_max) {
+			continue;
+		}
+		if (token && !bloom_test(segment, *token)) {
+			continue;
+		}
+
+		/* Start of oldest segment may have been evicted already */
+		if (!idx && !segs->num_untracked) {
+			iter = log->ptr_first;
+		} else {
+			iter = segment->first;
+		}
+		ret = scan_entries(segs, iter, segment->num_entries, visit, priv);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "objectlog.h"
+
+#define OBJECTLOG_SEGMENT_MAX_TOKENS 16
+#define OBJECTLOG_SEGMENT_BLOOM_BITS 256
+
+typedef struct {
+	objectlog_iterator_t first;
+	unsigned int num_entries;
+	/* Number of objects with a key, bounds are only valid if non-zero */
+	unsigned int num_keys;
+	uint64_t key_min;
+	uint64_t key_max;
+	uint8_t bloom[OBJECTLOG_SEGMENT_BLOOM_BITS / 8];
+} objectlog_segment_t;
+
+/*
+ * Extract key and up to OBJECTLOG_SEGMENT_MAX_TOKENS token hashes from
+ * object at @entry. Returns 0 if the object has a key, non-zero if it does
+ * not.
+ */
+typedef int (*objectlog_segment_extract_t)(objectlog_t *log, const objectlog_iterator_t *entry,
+					   void *priv, uint64_t *key, uint64_t *tokens,
+					   unsigned int *num_tokens);
+
+/* Returns non-zero to stop scanning */
+typedef int (*objectlog_segment_visit_t)(objectlog_t *log, const objectlog_iterator_t *entry,
+					 void *priv);
+
+typedef struct {
+	objectlog_t *log;
+	objectlog_observer_t observer;
+	objectlog_segment_extract_t extract;
+	void *priv;
+	objectlog_segment_t *segments;
+	unsigned int size;
+	unsigned int first;
+	unsigned int num_segments;
+	scatter_size_t segment_size;
+	/* Objects in the log not covered by any segment */
+	unsigned int num_untracked;
+} objectlog_segments_t;
+
+void objectlog_segments_init(objectlog_segments_t *segs, objectlog_t *log,
+			     objectlog_segment_t *segments, unsigned int size,
+			     scatter_size_t segment_size,
+			     objectlog_segment_extract_t extract, void *priv);
+void objectlog_segments_release(objectlog_segments_t *segs);
+uint64_t objectlog_segment_hash(const void *data, size_t len);
+int objectlog_segment_scan(objectlog_segments_t *segs, uint64_t key_min, uint64_t key_max,
+			   const uint64_t *token, objectlog_segment_visit_t visit, void *priv);
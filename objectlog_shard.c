@@ -0,0 +1,176 @@
+#include "objectlog_shard.h"
+
+/*
+ * Each shard is a regular object log over an even slice of a shared storage
+ * pool. Objects are prefixed by a global sequence number, stored in
+ * fragments of their own. Writers only touch their own shard and the
+ * sequence counter, readers merge all shards by sequence number.
+ */
+
+typedef uint64_t shard_seq_t;
+
+/* Advance @iter from start of object to first payload fragment */
+static void shard_skip_seq(objectlog_t *log, objectlog_iterator_t *iter) {
+	scatter_size_t skipped = 0;
+
+	while (skipped < sizeof(shard_seq_t) && !objectlog_iterator_is_err(iter)) {
+		uint8_t len;
+
+		objectlog_get_fragment(log, iter, &len);
+		skipped += len;
+		objectlog_next(log, iter);
+	}
+}
+
+/**
+ * Initialize @num_shards object logs in @logs over even slices of @pool
+ *
+ * @returns: 0 on success, -1 on failure
+ */
+int objectlog_shards_init(objectlog_shards_t *shards, objectlog_t *logs, unsigned int num_shards,
+			  const scatter_object_t *pool) {
+	const scatter_object_t *sc_entry = pool;
+	scatter_size_t pool_offset = 0;
+	scatter_size_t slice_size;
+	unsigned int num_pool = 0;
+	unsigned int shard;
+
+	while (sc_entry++->len) {
+		num_pool++;
+	}
+	if (!num_shards || num_shards > OBJECTLOG_SHARD_MAX || !num_pool) {
+		return -1;
+	}
+	slice_size = scatter_list_size(pool) / num_shards;
+
+	sc_entry = pool;
+	for (shard = 0; shard < num_shards; shard++) {
+		scatter_object_t slice[num_pool + 1];
+		scatter_size_t slice_left = slice_size;
+		unsigned int num_slice = 0;
+		int err;
+
+		/* Last shard takes any remainder */
+		if (shard == num_shards - 1) {
+			slice_left = scatter_list_size(pool) - shard * slice_size;
+		}
+		while (slice_left && sc_entry->len) {
+			scatter_size_t len = sc_entry->len - pool_offset;
+
+			if (len > slice_left) {
+				len = slice_left;
+			}
+			slice[num_slice].ptr = (uint8_t *)sc_entry->ptr + pool_offset;
+			slice[num_slice].len = len;
+			num_slice++;
+			slice_left -= len;
+			pool_offset += len;
+			if (pool_offset >= sc_entry->len) {
+				sc_entry++;
+				pool_offset = 0;
+			}
+		}
+		slice[num_slice].ptr = NULL;
+		slice[num_slice].len = 0;
+
+		err = objectlog_init_fragmented(&logs[shard], slice);
+		if (err) {
+			return err;
+		}
+	}
+
+	shards->logs = logs;
+	shards->num_shards = num_shards;
+	atomic_init(&shards->seq, 0);
+	return 0;
+}
+
+/**
+ * Write object from non-contiguous memory area to shard @shard
+ * Each shard must only be written to by a single thread at a time.
+ *
+ * @returns: 0 on success, number of bytes missing for storage on failure
+ */
+scatter_size_t objectlog_shard_write_scattered_object(objectlog_shards_t *shards,
+						      unsigned int shard,
+						      const scatter_object_t *scatter_list) {
+	shard_seq_t seq;
+
+	seq = atomic_fetch_add_explicit(&shards->seq, 1, memory_order_relaxed);
+	return objectlog_write_prefixed_object(&shards->logs[shard], &seq, sizeof(seq),
+					       scatter_list);
+}
+
+scatter_size_t objectlog_shard_write_object(objectlog_shards_t *shards, unsigned int shard,
+					    const void *data, scatter_size_t len) {
+	scatter_object_t scatter_list[] = {
+		/* Cast to non-const for compatibility, still never written */
+		{ .ptr = (void *)data, .len = len },
+		{ .len = 0 }
+	};
+
+	return objectlog_shard_write_scattered_object(shards, shard, scatter_list);
+}
+
+static void merge_load(objectlog_shard_merge_t *merge, unsigned int shard) {
+	objectlog_t *log = &merge->shards->logs[shard];
+	shard_seq_t seq;
+
+	if (merge->num_left[shard]) {
+		objectlog_read_object(log, &merge->entry[shard], 0, &seq, sizeof(seq));
+		merge->seq[shard] = seq;
+	}
+}
+
+/**
+ * Start ordered iteration over all objects of all shards
+ * Shards must not be written to while iterating.
+ */
+void objectlog_shard_merge_init(objectlog_shard_merge_t *merge, objectlog_shards_t *shards) {
+	unsigned int shard;
+
+	merge->shards = shards;
+	for (shard = 0; shard < shards->num_shards; shard++) {
+		merge->entry[shard] = shards->logs[shard].ptr_first;
+		merge->num_left[shard] = shards->logs[shard].num_entries;
+		merge_load(merge, shard);
+	}
+}
+
+/**
+ * Obtain iterator for object with next lowest sequence number
+ * @iterator points to the first payload fragment of the object in the log
+ * of shard @shard, objects without payload yield an error iterator.
+ *
+ * @returns: 0 on success, -1 once all objects have been visited
+ */
+int objectlog_shard_merge_next(objectlog_shard_merge_t *merge, unsigned int *shard,
+			       uint64_t *seq, objectlog_iterator_t *iterator) {
+	unsigned int min_shard = merge->shards->num_shards;
+	unsigned int idx;
+	objectlog_t *log;
+
+	for (idx = 0; idx < merge->shards->num_shards; idx++) {
+		if (!merge->num_left[idx]) {
+			continue;
+		}
+		if (min_shard >= merge->shards->num_shards ||
+		    merge->seq[idx] < merge->seq[min_shard]) {
+			min_shard = idx;
+		}
+	}
+	if (min_shard >= merge->shards->num_shards) {
+		return -1;
+	}
+
+	log = &merge->shards->logs[min_shard];
+	*shard = min_shard;
+	*seq = merge->seq[min_shard];
+	*iterator = merge->entry[min_shard];
+	shard_skip_seq(log, iterator);
+
+	objectlog_next_entry(log, &merge->entry[min_shard]);
+	merge->num_left[min_shard]--;
+	merge_load(merge, min_shard);
+	return 0;
+}
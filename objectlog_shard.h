@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "objectlog.h"
+#include "scatter.h"
+
+#define OBJECTLOG_SHARD_MAX 64
+#define OBJECTLOG_SHARD_CACHELINE 64
+
+typedef struct {
+	objectlog_t *logs;
+	unsigned int num_shards;
+	/* Written by every writer, on a line of its own to not share it with @logs */
+	_Alignas(OBJECTLOG_SHARD_CACHELINE) atomic_uint_fast64_t seq;
+} objectlog_shards_t;
+
+typedef struct {
+	objectlog_shards_t *shards;
+	/* Next object of each shard and number of objects left in shard */
+	objectlog_iterator_t entry[OBJECTLOG_SHARD_MAX];
+	uint64_t seq[OBJECTLOG_SHARD_MAX];
+	unsigned int num_left[OBJECTLOG_SHARD_MAX];
+} objectlog_shard_merge_t;
+
+int objectlog_shards_init(objectlog_shards_t *shards, objectlog_t *logs, unsigned int num_shards,
+			  const scatter_object_t *pool);
+scatter_size_t objectlog_shard_write_scattered_object(objectlog_shards_t *shards,
+						      unsigned int shard,
+						      const scatter_object_t *scatter_list);
+scatter_size_t objectlog_shard_write_object(objectlog_shards_t *shards, unsigned int shard,
+					    const void *data, scatter_size_t len);
+void objectlog_shard_merge_init(objectlog_shard_merge_t *merge, objectlog_shards_t *shards);
+int objectlog_shard_merge_next(objectlog_shard_merge_t *merge, unsigned int *shard,
+			       uint64_t *seq, objectlog_iterator_t *iterator);
@@ -0,0 +1,179 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "scatter_hugepage.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+/* From linux/mempolicy.h, avoids dependency on libnuma */
+#define HUGEPAGE_MPOL_BIND 2
+
+#define SZ_2M (2UL << 20)
+#define SZ_1G (1UL << 30)
+
+#define ALIGN_UP_POW2(x, align) (((x) + ((align) - 1)) & ~((align) - 1))
+
+#define HUGEPAGE_MAX_NODES 1024
+#define BITS_PER_LONG (8 * sizeof(unsigned long))
+
+static void *hugepage_map(size_t len, int flags) {
+	void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+
+	return addr == MAP_FAILED ? NULL : addr;
+}
+
+/* Map @len bytes aligned to @align, thus transparent hugepages can back all of it */
+static void *hugepage_map_aligned(size_t len, size_t align) {
+	uint8_t *addr = hugepage_map(len + align, 0);
+	uint8_t *aligned;
+
+	if (!addr) {
+		return NULL;
+	}
+	aligned = (uint8_t *)ALIGN_UP_POW2((uintptr_t)addr, align);
+	if (aligned > addr) {
+		munmap(addr, aligned - addr);
+	}
+	munmap(aligned + len, addr + align - aligned);
+	return aligned;
+}
+
+static int hugepage_bind(void *addr, size_t len, int numa_node) {
+	unsigned long nodemask[HUGEPAGE_MAX_NODES / BITS_PER_LONG] = { 0 };
+
+	nodemask[numa_node / BITS_PER_LONG] |= 1UL << (numa_node % BITS_PER_LONG);
+	/* Kernel only considers @maxnode - 1 bits of the mask */
+	if (syscall(SYS_mbind, addr, len, HUGEPAGE_MPOL_BIND, nodemask,
+		    HUGEPAGE_MAX_NODES + 1, 0)) {
+		return -errno;
+	}
+	return 0;
+}
+
+/*
+ * Bind storage to @numa_node and fault it in
+ * Hugetlb reservations are not node aware, touching bound hugetlb pages
+ * raises SIGBUS once the node runs out of them. MADV_POPULATE_WRITE reports
+ * an error instead, without it bound hugetlb storage is refused.
+ */
+static int hugepage_populate(void *addr, size_t len, int numa_node, bool hugetlb) {
+	int err;
+
+	if (numa_node != SCATTER_HUGEPAGE_NO_NODE) {
+		err = hugepage_bind(addr, len, numa_node);
+		if (err) {
+			return err;
+		}
+	}
+
+#ifdef MADV_POPULATE_WRITE
+	if (!madvise(addr, len, MADV_POPULATE_WRITE)) {
+		return 0;
+	}
+	/* Kernels before 5.14 do not know MADV_POPULATE_WRITE */
+	if (errno != EINVAL) {
+		return -errno;
+	}
+#endif
+	if (hugetlb && numa_node != SCATTER_HUGEPAGE_NO_NODE) {
+		return -ENOMEM;
+	}
+	memset(addr, 0, len);
+	return 0;
+}
+
+/**
+ * Allocate @size bytes of log storage backed by hugepages
+ * Explicit hugepages are tried first, 1 GiB pages only if
+ * SCATTER_HUGEPAGE_1G is set. Unless SCATTER_HUGEPAGE_NO_FALLBACK is set
+ * regular pages marked for transparent hugepage use are allocated if no
+ * explicit hugepages are available. If @numa_node is not
+ * SCATTER_HUGEPAGE_NO_NODE storage is bound to that node, explicit
+ * hugepages are skipped if that node has none left.
+ * Storage is faulted in before returning, thus the first write to the log
+ * does not stall on page faults.
+ *
+ * @returns: 0 on success, negative error code on failure
+ */
+int scatter_hugepage_alloc(scatter_hugepage_t *hp, scatter_size_t size, int numa_node,
+			   unsigned int flags) {
+	void *addr = NULL;
+	size_t map_len = 0;
+	size_t page_size = 0;
+	int err;
+
+	if (!size || numa_node < SCATTER_HUGEPAGE_NO_NODE || numa_node >= HUGEPAGE_MAX_NODES) {
+		return -EINVAL;
+	}
+
+	if (flags & SCATTER_HUGEPAGE_1G) {
+		map_len = ALIGN_UP_POW2(size, SZ_1G);
+		addr = hugepage_map(map_len, MAP_HUGETLB | MAP_HUGE_1GB);
+		page_size = SZ_1G;
+		if (addr && hugepage_populate(addr, map_len, numa_node, true)) {
+			munmap(addr, map_len);
+			addr = NULL;
+		}
+	}
+	if (!addr) {
+		map_len = ALIGN_UP_POW2(size, SZ_2M);
+		addr = hugepage_map(map_len, MAP_HUGETLB | MAP_HUGE_2MB);
+		page_size = SZ_2M;
+		if (addr && hugepage_populate(addr, map_len, numa_node, true)) {
+			munmap(addr, map_len);
+			addr = NULL;
+		}
+	}
+	if (!addr) {
+		if (flags & SCATTER_HUGEPAGE_NO_FALLBACK) {
+			return -ENOMEM;
+		}
+		map_len = ALIGN_UP_POW2(size, SZ_2M);
+		addr = hugepage_map_aligned(map_len, SZ_2M);
+		if (!addr) {
+			return -ENOMEM;
+		}
+		page_size = sysconf(_SC_PAGESIZE);
+#ifdef MADV_HUGEPAGE
+		/* Best effort, transparent hugepages might be disabled */
+		madvise(addr, map_len, MADV_HUGEPAGE);
+#endif
+		err = hugepage_populate(addr, map_len, numa_node, false);
+		if (err) {
+			munmap(addr, map_len);
+			return err;
+		}
+	}
+
+	hp->addr = addr;
+	hp->map_len = map_len;
+	hp->page_size = page_size;
+	hp->scatter_list[0].ptr = addr;
+	hp->scatter_list[0].len = map_len;
+	hp->scatter_list[1].ptr = NULL;
+	hp->scatter_list[1].len = 0;
+	return 0;
+}
+
+void scatter_hugepage_free(scatter_hugepage_t *hp) {
+	if (hp->addr) {
+		munmap(hp->addr, hp->map_len);
+	}
+	hp->addr = NULL;
+	hp->scatter_list[0].ptr = NULL;
+	hp->scatter_list[0].len = 0;
+}
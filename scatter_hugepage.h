@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "scatter.h"
+
+/* Try 1 GiB pages before 2 MiB pages */
+#define SCATTER_HUGEPAGE_1G		0x01
+/* Fail instead of falling back to regular pages */
+#define SCATTER_HUGEPAGE_NO_FALLBACK	0x02
+
+#define SCATTER_HUGEPAGE_NO_NODE	-1
+
+typedef struct {
+	/* Scatter list ready for objectlog_init_fragmented */
+	scatter_object_t scatter_list[2];
+	void *addr;
+	size_t map_len;
+	size_t page_size;
+} scatter_hugepage_t;
+
+int scatter_hugepage_alloc(scatter_hugepage_t *hp, scatter_size_t size, int numa_node,
+			   unsigned int flags);
+void scatter_hugepage_free(scatter_hugepage_t *hp);
@@ -0,0 +1,77 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "scatter_mirror.h"
+
+#define ALIGN_UP_POW2(x, align) (((x) + ((align) - 1)) & ~((align) - 1))
+
+/**
+ * Allocate ring storage of at least @size bytes mapped twice back to back
+ * A single page in front of the ring holds the scatter list.
+ *
+ * Layout: | meta page | ring | ring mirror |
+ *
+ * @returns: 0 on success, negative error code on failure
+ */
+int scatter_mirror_alloc(scatter_mirror_t *mirror, scatter_size_t size) {
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t ring_len = ALIGN_UP_POW2(size, page_size);
+	size_t map_len = page_size + 2 * ring_len;
+	uint8_t *addr;
+	int err = 0;
+	int fd;
+
+	if (!size) {
+		return -EINVAL;
+	}
+
+	fd = memfd_create("objectlog", MFD_CLOEXEC);
+	if (fd < 0) {
+		return -errno;
+	}
+	if (ftruncate(fd, ring_len)) {
+		err = -errno;
+		goto out_fd;
+	}
+
+	/* Reserve address space for all mappings first */
+	addr = mmap(NULL, map_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		err = -errno;
+		goto out_fd;
+	}
+	if (mmap(addr, page_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED ||
+	    mmap(addr + page_size, ring_len, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+	    mmap(addr + page_size + ring_len, ring_len, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		err = -errno;
+		munmap(addr, map_len);
+		goto out_fd;
+	}
+
+	mirror->addr = addr;
+	mirror->map_len = map_len;
+	mirror->meta = addr;
+	mirror->meta_len = page_size;
+	mirror->ring.ptr = addr + page_size;
+	mirror->ring.len = ring_len;
+
+out_fd:
+	/* Mappings keep the memory alive */
+	close(fd);
+	return err;
+}
+
+void scatter_mirror_free(scatter_mirror_t *mirror) {
+	if (mirror->addr) {
+		munmap(mirror->addr, mirror->map_len);
+	}
+	mirror->addr = NULL;
+	mirror->ring.ptr = NULL;
+	mirror->ring.len = 0;
+}
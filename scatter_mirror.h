@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "scatter.h"
+
+typedef struct {
+	/* Double mapped region for objectlog_init_mirrored */
+	scatter_object_t ring;
+	/* Scatter list storage for objectlog_init_mirrored */
+	void *meta;
+	scatter_size_t meta_len;
+	void *addr;
+	size_t map_len;
+} scatter_mirror_t;
+
+int scatter_mirror_alloc(scatter_mirror_t *mirror, scatter_size_t size);
+void scatter_mirror_free(scatter_mirror_t *mirror);